@@ -73,6 +73,16 @@ if (WITH_DCACHE)
   add_definitions(-DVIRTIO_USE_DCACHE)
 endif (WITH_DCACHE)
 
+option (WITH_CACHE_LINE_ALIGN "Build with cache line aligned vrings and buffers" OFF)
+
+if (WITH_CACHE_LINE_ALIGN)
+  add_definitions(-DVIRTIO_CACHE_LINE_ALIGN)
+endif (WITH_CACHE_LINE_ALIGN)
+
+if (DEFINED VIRTIO_CACHE_LINE_SIZE)
+  add_definitions( -DVIRTIO_CACHE_LINE_SIZE=${VIRTIO_CACHE_LINE_SIZE} )
+endif (DEFINED VIRTIO_CACHE_LINE_SIZE)
+
 # Set the complication flags
 set (CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -Wall -Wextra")
 
@@ -92,6 +102,22 @@ if (DEFINED RPMSG_BUFFER_SIZE)
   add_definitions( -DRPMSG_BUFFER_SIZE=${RPMSG_BUFFER_SIZE} )
 endif (DEFINED RPMSG_BUFFER_SIZE)
 
+if (DEFINED RPMSG_VIRTIO_MAX_QUEUES)
+  add_definitions( -DRPMSG_VIRTIO_MAX_QUEUES=${RPMSG_VIRTIO_MAX_QUEUES} )
+endif (DEFINED RPMSG_VIRTIO_MAX_QUEUES)
+
+if (DEFINED RPMSG_SHM_POOL_NUM_CLASSES)
+  add_definitions( -DRPMSG_SHM_POOL_NUM_CLASSES=${RPMSG_SHM_POOL_NUM_CLASSES} )
+endif (DEFINED RPMSG_SHM_POOL_NUM_CLASSES)
+
+if (DEFINED RPMSG_ADDR_BMP_SIZE)
+  add_definitions( -DRPMSG_ADDR_BMP_SIZE=${RPMSG_ADDR_BMP_SIZE} )
+endif (DEFINED RPMSG_ADDR_BMP_SIZE)
+
+if (DEFINED RPMSG_EPT_HASH_SIZE)
+  add_definitions( -DRPMSG_EPT_HASH_SIZE=${RPMSG_EPT_HASH_SIZE} )
+endif (DEFINED RPMSG_EPT_HASH_SIZE)
+
 option (WITH_DOC "Build with documentation" OFF)
 
 message ("-- C_FLAGS : ${CMAKE_C_FLAGS}")
@@ -26,11 +26,19 @@ extern "C" {
 
 /* Configurable parameters */
 #define RPMSG_NAME_SIZE			(32)
+#ifndef RPMSG_ADDR_BMP_SIZE
 #define RPMSG_ADDR_BMP_SIZE		(128)
+#endif
+
+/* Number of buckets of the endpoint lookup tables, must be a power of 2 */
+#ifndef RPMSG_EPT_HASH_SIZE
+#define RPMSG_EPT_HASH_SIZE		(64)
+#endif
 
 #define RPMSG_NS_EPT_ADDR		(0x35)
 #define RPMSG_RESERVED_ADDRESSES	(1024)
 #define RPMSG_ADDR_ANY			0xFFFFFFFF
+#define RPMSG_QUEUE_ANY			0xFFFFFFFF
 
 /* Error macros. */
 #define RPMSG_SUCCESS			0
@@ -48,9 +56,33 @@ extern "C" {
 struct rpmsg_endpoint;
 struct rpmsg_device;
 
+/** @brief Chunk of a message gathered by the vectored send functions */
+struct rpmsg_iovec {
+	/** Start of the chunk */
+	const void *base;
+
+	/** Length of the chunk */
+	size_t len;
+};
+
+/** @brief Received message given to a batch rx callback */
+struct rpmsg_rx_desc {
+	/** Payload of the message, in the shared rx buffer */
+	void *data;
+
+	/** Length of the payload */
+	size_t len;
+
+	/** Source address of the message */
+	uint32_t src;
+};
+
 /* Returns positive value on success or negative error value on failure */
 typedef int (*rpmsg_ept_cb)(struct rpmsg_endpoint *ept, void *data,
 			    size_t len, uint32_t src, void *priv);
+typedef int (*rpmsg_ept_batch_cb)(struct rpmsg_endpoint *ept,
+				  struct rpmsg_rx_desc *msgs, int num,
+				  void *priv);
 typedef void (*rpmsg_ept_release_cb)(struct rpmsg_endpoint *ept);
 typedef void (*rpmsg_ns_unbind_cb)(struct rpmsg_endpoint *ept);
 typedef void (*rpmsg_ns_bind_cb)(struct rpmsg_device *rdev,
@@ -78,29 +110,82 @@ struct rpmsg_endpoint {
 	/** Reference count for determining whether the endpoint can be deallocated */
 	uint32_t refcnt;
 
+	/** Transport queue the endpoint sends on, RPMSG_QUEUE_ANY if not bound */
+	uint32_t queue;
+
 	/** Callback to inform the user that the endpoint allocation can be safely removed */
 	rpmsg_ept_release_cb release_cb;
 
 	/**
 	 * User rx callback, return value of this callback is reserved for future
-	 * use, for now, only allow RPMSG_SUCCESS as return value
+	 * use, for now, only allow RPMSG_SUCCESS as return value. NULL if the
+	 * messages are read with rpmsg_recv_nocopy().
 	 */
 	rpmsg_ept_cb cb;
 
+	/** User rx callback for batches of messages, replaces cb if set */
+	rpmsg_ept_batch_cb batch_cb;
+
 	/** Endpoint service unbind callback, called when remote ept is destroyed */
 	rpmsg_ns_unbind_cb ns_unbind_cb;
 
 	/** Endpoint node */
 	struct metal_list node;
 
+	/** Next endpoint in the same local address hash bucket */
+	struct rpmsg_endpoint *addr_next;
+
+	/** Next endpoint in the same name hash bucket */
+	struct rpmsg_endpoint *name_next;
+
 	/** Private data for the driver's use */
 	void *priv;
+
+	/** Whether the messages larger than a buffer are sent in fragments */
+	bool frag;
+
+	/** Whether a fragmented message is being reassembled without error */
+	bool frag_valid;
+
+	/** Buffer the received fragmented messages are reassembled in */
+	void *frag_buf;
+
+	/** Size of the reassembly buffer */
+	size_t frag_size;
+
+	/** Length of the message reassembled so far */
+	size_t frag_len;
+
+	/** Source address of the message reassembled */
+	uint32_t frag_src;
+
+	/** Serializes the fragments of the messages sent by the endpoint */
+	metal_mutex_t frag_tx_lock;
+
+	/**
+	 * Protects the reassembly state against the fragments received
+	 * concurrently on several queue pairs
+	 */
+	metal_mutex_t frag_rx_lock;
+
+	/** Received messages queued for a deferred dispatch */
+	struct metal_list rx_msgs;
+
+	/** Node in the list of the endpoints with queued messages to dispatch */
+	struct metal_list rx_node;
+
+	/** Whether the endpoint is in the list of endpoints to dispatch */
+	bool rx_ready;
+
+	/** Whether a worker is dispatching the queued messages of the endpoint */
+	bool rx_running;
 };
 
 /** @brief RPMsg device operations */
 struct rpmsg_device_ops {
-	/** Send RPMsg data */
+	/** Send RPMsg data of an endpoint */
 	int (*send_offchannel_raw)(struct rpmsg_device *rdev,
+				   struct rpmsg_endpoint *ept,
 				   uint32_t src, uint32_t dst,
 				   const void *data, int len, int wait);
 
@@ -127,6 +212,42 @@ struct rpmsg_device_ops {
 
 	/** Get RPMsg TX buffer size */
 	int (*get_tx_buffer_size)(struct rpmsg_device *rdev);
+
+	/** Notify the remote of the messages sent and not notified yet */
+	int (*flush)(struct rpmsg_device *rdev);
+
+	/** Send RPMsg data of an endpoint gathered from several chunks */
+	int (*sendv_offchannel_raw)(struct rpmsg_device *rdev,
+				    struct rpmsg_endpoint *ept,
+				    uint32_t src, uint32_t dst,
+				    const struct rpmsg_iovec *iov, int iovcnt,
+				    int wait);
+
+	/** Send several RPMsg messages of an endpoint */
+	int (*send_offchannel_batch)(struct rpmsg_device *rdev,
+				     struct rpmsg_endpoint *ept,
+				     uint32_t src, uint32_t dst,
+				     const struct rpmsg_iovec *msgs, int num,
+				     int wait);
+
+	/** Send several RPMsg messages without copy */
+	int (*send_offchannel_nocopy_batch)(struct rpmsg_device *rdev,
+					    uint32_t src, uint32_t dst,
+					    const struct rpmsg_iovec *msgs,
+					    int num);
+
+	/** Get several RPMsg TX buffers */
+	int (*get_tx_payload_buffers)(struct rpmsg_device *rdev,
+				      void **buffers, int num, uint32_t *len,
+				      int wait);
+
+	/** Receive RPMsg data without copy */
+	int (*recv_nocopy)(struct rpmsg_device *rdev,
+			   struct rpmsg_endpoint *ept, void **data,
+			   uint32_t *src, uint32_t timeout_us);
+
+	/** Prepare the queueing of the messages received with recv_nocopy */
+	int (*enable_recv_nocopy)(struct rpmsg_device *rdev);
 };
 
 /** @brief Representation of a RPMsg device */
@@ -134,6 +255,12 @@ struct rpmsg_device {
 	/** List of endpoints */
 	struct metal_list endpoints;
 
+	/** Endpoints hashed by local address, for the rx dispatch */
+	struct rpmsg_endpoint *addr_hash[RPMSG_EPT_HASH_SIZE];
+
+	/** Endpoints hashed by name, for the name service */
+	struct rpmsg_endpoint *name_hash[RPMSG_EPT_HASH_SIZE];
+
 	/** Name service endpoint */
 	struct rpmsg_endpoint ns_ept;
 
@@ -141,7 +268,14 @@ struct rpmsg_device {
 	unsigned long bitmap[metal_bitmap_longs(RPMSG_ADDR_BMP_SIZE)];
 	unsigned int bitnext;
 
-	/** Mutex lock for RPMsg management */
+	/** Summary of the address bitmap, a bit is set when its word is full */
+	unsigned long bitmap_full[metal_bitmap_longs(metal_bitmap_longs(RPMSG_ADDR_BMP_SIZE))];
+
+	/**
+	 * Mutex lock protecting the endpoints and the address allocation. The
+	 * transport may protect its queues with locks of its own, taken before
+	 * this one.
+	 */
 	metal_mutex_t lock;
 
 	/** Callback handler for name service announcement without local epts waiting to bind */
@@ -155,6 +289,9 @@ struct rpmsg_device {
 
 	/** Create/destroy namespace message */
 	bool support_ns;
+
+	/** Fragmented messages, an OpenAMP only VIRTIO_RPMSG_F_FRAG extension */
+	bool support_frag;
 };
 
 /**
@@ -332,6 +469,162 @@ static inline int rpmsg_trysend_offchannel(struct rpmsg_endpoint *ept,
 	return rpmsg_send_offchannel_raw(ept, src, dst, data, len, false);
 }
 
+/**
+ * @brief Send a message gathered from several chunks, specifying source and
+ * destination address.
+ *
+ * This function sends the concatenation of the `iovcnt` chunks of `iov` to the
+ * remote `dst` address from the source `src` address. The chunks are copied
+ * directly into the tx buffer, without an intermediate staging buffer.
+ *
+ * @param ept		The rpmsg endpoint
+ * @param src		Source endpoint address of the message
+ * @param dst		Destination endpoint address of the message
+ * @param iov		Array of chunks of the payload
+ * @param iovcnt	Number of chunks
+ * @param wait		Boolean value indicating whether to wait on buffers
+ *
+ * @return Number of bytes it has sent or negative error value on failure.
+ */
+int rpmsg_sendv_offchannel_raw(struct rpmsg_endpoint *ept, uint32_t src,
+			       uint32_t dst, const struct rpmsg_iovec *iov,
+			       int iovcnt, int wait);
+
+/**
+ * @brief Send a message gathered from several chunks to the remote processor
+ *
+ * This function is the vectored version of rpmsg_send(). In case there are no
+ * TX buffers available, the function will block until one becomes available,
+ * or a timeout of 15 seconds elapses.
+ *
+ * @param ept		The rpmsg endpoint
+ * @param iov		Array of chunks of the payload
+ * @param iovcnt	Number of chunks
+ *
+ * @return Number of bytes it has sent or negative error value on failure.
+ */
+static inline int rpmsg_sendv(struct rpmsg_endpoint *ept,
+			      const struct rpmsg_iovec *iov, int iovcnt)
+{
+	if (!ept)
+		return RPMSG_ERR_PARAM;
+
+	return rpmsg_sendv_offchannel_raw(ept, ept->addr, ept->dest_addr, iov,
+					  iovcnt, true);
+}
+
+/**
+ * @brief Send a message gathered from several chunks to the remote processor
+ *
+ * This function is the vectored version of rpmsg_trysend(). In case there are
+ * no TX buffers available, the function will immediately return -ENOMEM
+ * without waiting until one becomes available.
+ *
+ * @param ept		The rpmsg endpoint
+ * @param iov		Array of chunks of the payload
+ * @param iovcnt	Number of chunks
+ *
+ * @return Number of bytes it has sent or negative error value on failure.
+ */
+static inline int rpmsg_trysendv(struct rpmsg_endpoint *ept,
+				 const struct rpmsg_iovec *iov, int iovcnt)
+{
+	if (!ept)
+		return RPMSG_ERR_PARAM;
+
+	return rpmsg_sendv_offchannel_raw(ept, ept->addr, ept->dest_addr, iov,
+					  iovcnt, false);
+}
+
+/**
+ * @brief Notify the remote of the messages sent and not notified yet
+ *
+ * When the transport coalesces its notifications, see
+ * rpmsg_virtio_set_tx_coalescing(), the last messages of a burst are not
+ * notified to the remote until this function is called. Calling it after the
+ * last message of each burst, or from a periodic timer to bound the latency,
+ * is enough.
+ *
+ * @param ept	The rpmsg endpoint
+ *
+ * @return RPMSG_SUCCESS on success, otherwise error code
+ */
+int rpmsg_flush(struct rpmsg_endpoint *ept);
+
+/**
+ * @brief Send several messages, specifying source and destination address.
+ *
+ * Each element of `msgs` is a whole message, sent in its own tx buffer. The
+ * tx buffers of the messages are reserved and published to the remote in
+ * batches, and the remote is notified once for all of them. A message larger
+ * than a tx buffer is neither truncated nor fragmented, it is rejected with
+ * RPMSG_ERR_PARAM. The host checks all the messages before sending any, the
+ * remote only knows the size of the buffers once reserved, so it sends the
+ * messages before the rejected one and returns their number.
+ *
+ * If the tx buffers run out, the messages that could not be sent are the last
+ * ones: without wait the function returns the number of messages sent so far,
+ * with wait it keeps waiting for buffers as rpmsg_send() does.
+ *
+ * @param ept	The rpmsg endpoint
+ * @param src	Source endpoint address of the messages
+ * @param dst	Destination endpoint address of the messages
+ * @param msgs	Array of the payloads of the messages
+ * @param num	Number of messages
+ * @param wait	Boolean value indicating whether to wait on buffers
+ *
+ * @return Number of messages sent, or negative error value if none was sent.
+ */
+int rpmsg_send_offchannel_batch(struct rpmsg_endpoint *ept, uint32_t src,
+				uint32_t dst, const struct rpmsg_iovec *msgs,
+				int num, int wait);
+
+/**
+ * @brief Send several messages to the remote processor
+ *
+ * This function is the batch version of rpmsg_send(). In case there are no
+ * TX buffers available, the function will block until one becomes available,
+ * or a timeout of 15 seconds elapses.
+ *
+ * @param ept	The rpmsg endpoint
+ * @param msgs	Array of the payloads of the messages
+ * @param num	Number of messages
+ *
+ * @return Number of messages sent, or negative error value if none was sent.
+ */
+static inline int rpmsg_send_batch(struct rpmsg_endpoint *ept,
+				   const struct rpmsg_iovec *msgs, int num)
+{
+	if (!ept)
+		return RPMSG_ERR_PARAM;
+
+	return rpmsg_send_offchannel_batch(ept, ept->addr, ept->dest_addr,
+					   msgs, num, true);
+}
+
+/**
+ * @brief Send several messages to the remote processor
+ *
+ * This function is the batch version of rpmsg_trysend(). In case the TX
+ * buffers run out, the function returns the number of messages sent so far
+ * without waiting until one becomes available.
+ *
+ * @param ept	The rpmsg endpoint
+ * @param msgs	Array of the payloads of the messages
+ * @param num	Number of messages
+ *
+ * @return Number of messages sent, or negative error value if none was sent.
+ */
+static inline int rpmsg_trysend_batch(struct rpmsg_endpoint *ept,
+				      const struct rpmsg_iovec *msgs, int num)
+{
+	if (!ept)
+		return RPMSG_ERR_PARAM;
+
+	return rpmsg_send_offchannel_batch(ept, ept->addr, ept->dest_addr,
+					   msgs, num, false);
+}
+
 /**
  * @brief Holds the rx buffer for usage outside the receive callback.
  *
@@ -342,7 +635,8 @@ static inline int rpmsg_trysend_offchannel(struct rpmsg_endpoint *ept,
  * is saved in application context and further processed in application
  * process. After the message is processed, the application can release the rx
  * buffer for future reuse in vring by calling the rpmsg_release_rx_buffer()
- * function.
+ * function. A buffer can be held up to 255 times at once, further holds are
+ * ignored by the virtio transport.
  *
  * @param ept	The rpmsg endpoint
  * @param rxbuf RX buffer with message payload
@@ -364,6 +658,39 @@ void rpmsg_hold_rx_buffer(struct rpmsg_endpoint *ept, void *rxbuf);
  */
 void rpmsg_release_rx_buffer(struct rpmsg_endpoint *ept, void *rxbuf);
 
+/**
+ * @brief Receives the next message of an endpoint without copy.
+ *
+ * The messages of an endpoint created without callback are queued in their
+ * rx buffers until read with this function, in order. The message is not
+ * copied: data points to the payload in the rx buffer, which the application
+ * releases with rpmsg_release_rx_buffer() once processed. Fragments are
+ * received as separate messages if the fragmentation is enabled on the
+ * endpoint, and dropped otherwise.
+ *
+ * This API can only be called at process context. While no message is queued,
+ * it waits for the rx notifications with the wait callback of the transport,
+ * or sleeps, up to timeout_us. The timeout is counted in intervals of 1 ms,
+ * rounded up, and each return of the wait callback counts as one interval.
+ * With several queue pairs, the messages may arrive on any of them: the waits
+ * go round the queue pairs, starting with the one the endpoint sends on.
+ *
+ * @param ept		The rpmsg endpoint, created without callback
+ * @param data		Pointer to store the address of the payload
+ * @param src		Pointer to store the source address, or NULL
+ * @param timeout_us	Time to wait for a message in microseconds, 0 to
+ *			return right away
+ *
+ * @return Length of the payload on success, otherwise error code:
+ *   - RPMSG_ERR_NO_BUFF if no message was received in time
+ *   - RPMSG_ERR_PARAM on invalid parameter
+ *   - RPMSG_EOPNOTSUPP if not supported by the transport
+ *
+ * @see rpmsg_release_rx_buffer
+ */
+int rpmsg_recv_nocopy(struct rpmsg_endpoint *ept, void **data, uint32_t *src,
+		      uint32_t timeout_us);
+
 /**
  * @brief Gets the tx buffer for message payload.
  *
@@ -387,6 +714,34 @@ void rpmsg_release_rx_buffer(struct rpmsg_endpoint *ept, void *rxbuf);
 void *rpmsg_get_tx_payload_buffer(struct rpmsg_endpoint *ept,
 				  uint32_t *len, int wait);
 
+/**
+ * @brief Gets several tx buffers for message payloads.
+ *
+ * This function is the bulk version of rpmsg_get_tx_payload_buffer(). The
+ * device state is checked and the tx buffers reserved once for the whole
+ * batch. When waiting, only the first buffer is waited for: the function
+ * returns the buffers available at that time, up to num.
+ *
+ * The buffers are sent with rpmsg_send_nocopy_batch() or one by one with
+ * rpmsg_send_nocopy(), the unused ones are given back with
+ * rpmsg_release_tx_buffer().
+ *
+ * @param ept		Pointer to rpmsg endpoint
+ * @param buffers	Array to store the tx buffer addresses
+ * @param num		Number of tx buffers requested
+ * @param len		Pointer to store the size of the smallest tx buffer
+ * @param wait		Boolean, wait or not for buffer to become available
+ *
+ * @return Number of tx buffers reserved, 0 if none is available, or negative
+ * error value on failure.
+ *
+ * @see rpmsg_get_tx_payload_buffer
+ * @see rpmsg_send_nocopy_batch
+ * @see rpmsg_release_tx_buffer
+ */
+int rpmsg_get_tx_payload_buffers(struct rpmsg_endpoint *ept, void **buffers,
+				 int num, uint32_t *len, int wait);
+
 /**
  * @brief Releases unused buffer.
  *
@@ -545,6 +900,57 @@ static inline int rpmsg_send_nocopy(struct rpmsg_endpoint *ept,
 					    ept->dest_addr, data, len);
 }
 
+/**
+ * @brief Send several messages in tx buffers reserved by
+ * rpmsg_get_tx_payload_buffer() across to the remote processor, specifying
+ * source and destination address.
+ *
+ * This function is the batch version of rpmsg_send_offchannel_nocopy(). Each
+ * element of `msgs` is the payload of a tx buffer and the length of its
+ * message. The buffers are published to the remote in batches, and the remote
+ * is notified once for all of them. All the buffers are sent, and cannot be
+ * used by the application anymore.
+ *
+ * @param ept	The rpmsg endpoint
+ * @param src	The rpmsg endpoint local address
+ * @param dst	The rpmsg endpoint remote address
+ * @param msgs	Array of the tx buffers with messages filled
+ * @param num	Number of tx buffers
+ *
+ * @return Number of messages sent or negative error value on failure.
+ *
+ * @see rpmsg_get_tx_payload_buffer
+ * @see rpmsg_send_offchannel_nocopy
+ */
+int rpmsg_send_offchannel_nocopy_batch(struct rpmsg_endpoint *ept,
+				       uint32_t src, uint32_t dst,
+				       const struct rpmsg_iovec *msgs, int num);
+
+/**
+ * @brief Send several messages in tx buffers reserved by
+ * rpmsg_get_tx_payload_buffer() across to the remote processor.
+ *
+ * This function is the batch version of rpmsg_send_nocopy().
+ *
+ * @param ept	The rpmsg endpoint
+ * @param msgs	Array of the tx buffers with messages filled
+ * @param num	Number of tx buffers
+ *
+ * @return Number of messages sent or negative error value on failure.
+ *
+ * @see rpmsg_send_offchannel_nocopy_batch
+ */
+static inline int rpmsg_send_nocopy_batch(struct rpmsg_endpoint *ept,
+					  const struct rpmsg_iovec *msgs,
+					  int num)
+{
+	if (!ept)
+		return RPMSG_ERR_PARAM;
+
+	return rpmsg_send_offchannel_nocopy_batch(ept, ept->addr,
+						  ept->dest_addr, msgs, num);
+}
+
 /**
  * @brief Create rpmsg endpoint and register it to rpmsg device
  *
@@ -567,11 +973,14 @@ static inline int rpmsg_send_nocopy(struct rpmsg_endpoint *ept,
  * @param name		Service name associated to the endpoint (maximum size \ref RPMSG_NAME_SIZE)
  * @param src		Local address of the endpoint
  * @param dest		Target address of the endpoint
- * @param cb		Endpoint callback
+ * @param cb		Endpoint callback, NULL to read the messages with
+ *			rpmsg_recv_nocopy()
  * @param ns_unbind_cb	Endpoint service unbind callback, called when remote
  *			ept is destroyed.
  *
- * @return 0 on success, or negative error value on failure.
+ * @return 0 on success, or negative error value on failure:
+ *   - RPMSG_EOPNOTSUPP if cb is NULL and the transport does not support
+ *     rpmsg_recv_nocopy()
  */
 int rpmsg_create_ept(struct rpmsg_endpoint *ept, struct rpmsg_device *rdev,
 		     const char *name, uint32_t src, uint32_t dest,
@@ -587,6 +996,66 @@ int rpmsg_create_ept(struct rpmsg_endpoint *ept, struct rpmsg_device *rdev,
  */
 void rpmsg_destroy_ept(struct rpmsg_endpoint *ept);
 
+/**
+ * @brief Enable the fragmentation of the large messages of an endpoint
+ *
+ * Once enabled, a message sent by the endpoint that does not fit in a
+ * transport buffer is split over several buffers instead of being truncated.
+ * The fragments received by the endpoint are reassembled in rxbuf, and the
+ * endpoint callback is called once with the whole message. Both sides have to
+ * enable the fragmentation for the endpoints to exchange large messages, and
+ * the transport has to support it. Fragments received by an endpoint that did
+ * not enable the fragmentation are dropped.
+ *
+ * The fragments are copied once from the shared buffers to rxbuf, which are
+ * given back to the remote right away, so a reassembled message cannot be held
+ * with rpmsg_hold_rx_buffer(). A message that fits in a single buffer is still
+ * delivered from the shared buffer, and can be held.
+ *
+ * The large messages sent by several threads on the endpoint are sent one
+ * after the other. The fragments are reassembled for one remote endpoint at a
+ * time: while a message is reassembled, the large messages of the other remote
+ * endpoints are dropped. The reassembled messages are delivered one at a time,
+ * even when received on several queue pairs, so the endpoint callback must not
+ * call this function for the same endpoint.
+ *
+ * A send that fails with RPMSG_ERR_NO_BUFF after the first fragment leaves the
+ * remote endpoint with a truncated message: its receiver drops it only once
+ * the first fragment of the next message is received.
+ *
+ * @param ept	Pointer to rpmsg endpoint
+ * @param rxbuf	Reassembly buffer, NULL to receive the fragments as separate
+ *		messages
+ * @param size	Size of the reassembly buffer, the largest message accepted
+ *
+ * @return RPMSG_SUCCESS on success, otherwise error code:
+ *   - RPMSG_ERR_PARAM on invalid parameter
+ *   - RPMSG_EOPNOTSUPP if the fragmentation is not supported by the transport
+ */
+int rpmsg_enable_fragmentation(struct rpmsg_endpoint *ept, void *rxbuf,
+			       size_t size);
+
+/**
+ * @brief Set the batch rx callback of an endpoint
+ *
+ * Once set, the consecutive messages received by the endpoint in a single
+ * pass over the rx virtqueue are given together to batch_cb instead of one by
+ * one to the endpoint callback, and their buffers are given back together
+ * once it returns. The payloads point to the shared buffers, and can be held
+ * with rpmsg_hold_rx_buffer() as with the endpoint callback.
+ *
+ * Reassembled fragmented messages are still delivered to the endpoint
+ * callback. Transports without batch support call the endpoint callback.
+ *
+ * @param ept		Pointer to rpmsg endpoint
+ * @param batch_cb	Batch rx callback, NULL to call the endpoint callback
+ *			for each message again
+ *
+ * @return RPMSG_SUCCESS on success, otherwise error code
+ */
+int rpmsg_set_ept_batch_cb(struct rpmsg_endpoint *ept,
+			   rpmsg_ept_batch_cb batch_cb);
+
 /**
  * @brief Check if the rpmsg endpoint ready to send
  *
@@ -12,6 +12,7 @@
 #ifndef _RPMSG_VIRTIO_H_
 #define _RPMSG_VIRTIO_H_
 
+#include <metal/atomic.h>
 #include <metal/io.h>
 #include <metal/mutex.h>
 #include <metal/cache.h>
@@ -27,8 +28,23 @@ extern "C" {
 #define RPMSG_BUFFER_SIZE	(512)
 #endif
 
+/* Maximum number of rx/tx virtqueue pairs used by a device */
+#ifndef RPMSG_VIRTIO_MAX_QUEUES
+#define RPMSG_VIRTIO_MAX_QUEUES	(4)
+#endif
+
+/* Maximum number of buffer sizes managed by a shared memory pool */
+#ifndef RPMSG_SHM_POOL_NUM_CLASSES
+#define RPMSG_SHM_POOL_NUM_CLASSES	(4)
+#endif
+
 /* The feature bitmap for virtio rpmsg */
 #define VIRTIO_RPMSG_F_NS	0 /* RP supports name service notifications */
+/*
+ * RP supports fragmented messages. This bit is an OpenAMP extension, not part
+ * of the virtio specification: both sides have to be OpenAMP based to use it.
+ */
+#define VIRTIO_RPMSG_F_FRAG	1
 
 #if defined(VIRTIO_USE_DCACHE)
 #define BUFFER_FLUSH(x, s)		metal_cache_flush(x, s)
@@ -41,7 +57,82 @@ extern "C" {
 /* Callback handler for rpmsg virtio service */
 typedef int (*rpmsg_virtio_notify_wait_cb)(struct rpmsg_device *rdev, uint32_t id);
 
-/** @brief Shared memory pool used for RPMsg buffers */
+/*
+ * Callback handler to wait, up to *timeout_us, for the remote to release tx
+ * buffers, *timeout_us is updated with the time left
+ */
+typedef int (*rpmsg_virtio_tx_wait_cb)(struct rpmsg_device *rdev, uint32_t *timeout_us);
+
+/* Callback handler to wake up the senders waiting for tx buffers */
+typedef void (*rpmsg_virtio_tx_wake_cb)(struct rpmsg_device *rdev);
+
+/* Callback handler to schedule rpmsg_virtio_poll() calls */
+typedef void (*rpmsg_virtio_rx_poll_cb)(struct rpmsg_device *rdev);
+
+/* Callback handler to wake up the workers calling rpmsg_virtio_dispatch() */
+typedef void (*rpmsg_virtio_dispatch_cb)(struct rpmsg_device *rdev);
+
+/* Callback handler to start a one-shot timer calling rpmsg_virtio_notify_timeout() */
+typedef void (*rpmsg_virtio_notify_timer_cb)(struct rpmsg_device *rdev, uint32_t timeout_us);
+
+/** @brief Notification statistics of an rpmsg virtio device */
+struct rpmsg_virtio_notify_stats {
+	/** Notifications received for rx messages */
+	uint32_t rx_received;
+
+	/** Notifications received for released tx buffers */
+	uint32_t tx_done_received;
+
+	/** Notifications sent to the remote */
+	uint32_t sent;
+
+	/** Notifications to the remote suppressed on its request */
+	uint32_t suppressed;
+};
+
+/** @brief Buffer cache maintenance statistics of an rpmsg virtio device */
+struct rpmsg_virtio_cache_stats {
+	/** Bytes of tx buffers flushed */
+	uint64_t flushed;
+
+	/** Bytes of rx buffers invalidated */
+	uint64_t invalidated;
+};
+
+/** @brief Statistics of a size class of a shared memory pool */
+struct rpmsg_virtio_shm_pool_stats {
+	/** Size of the buffers of the class */
+	size_t size;
+
+	/** Number of buffers taken from the pool memory for the class */
+	unsigned int total;
+
+	/** Number of buffers of the class currently allocated */
+	unsigned int used;
+
+	/** Highest number of buffers of the class allocated at the same time */
+	unsigned int peak;
+
+	/** Number of allocations of the class that failed */
+	unsigned int failed;
+};
+
+/** @brief Size class of a shared memory pool */
+struct rpmsg_virtio_shm_pool_class {
+	/** Statistics of the class */
+	struct rpmsg_virtio_shm_pool_stats stats;
+
+	/** Free buffers of the class, linked through their first bytes */
+	void *free_list;
+};
+
+/**
+ * @brief Shared memory pool used for RPMsg buffers
+ *
+ * The buffers are carved from the pool memory on demand and returned to a
+ * free list of their size class when freed, so the pool can be reused after
+ * an RPMsg virtio device is deinitialized, or shared by several devices.
+ */
 struct rpmsg_virtio_shm_pool {
 	/** Base address of the memory pool */
 	void *base;
@@ -51,6 +142,15 @@ struct rpmsg_virtio_shm_pool {
 
 	/** Total pool size */
 	size_t size;
+
+	/** Size classes of the buffers allocated from the pool */
+	struct rpmsg_virtio_shm_pool_class classes[RPMSG_SHM_POOL_NUM_CLASSES];
+
+	/** Number of size classes in use */
+	unsigned int num_classes;
+
+	/** Mutex lock protecting the pool when shared */
+	metal_mutex_t lock;
 };
 
 /**
@@ -70,6 +170,57 @@ struct rpmsg_virtio_config {
 	bool split_shpool;
 };
 
+struct rpmsg_rx_msg;
+
+/** @brief Pair of rx/tx virtqueues of a RPMsg virtio device */
+struct rpmsg_virtio_queue {
+	/** Pointer to receive virtqueue */
+	struct virtqueue *rvq;
+
+	/** Pointer to send virtqueue */
+	struct virtqueue *svq;
+
+	/** Mutex lock protecting the send virtqueue and the tx buffers */
+	metal_mutex_t tx_lock;
+
+	/** Mutex lock protecting the receive virtqueue and the rx buffers */
+	metal_mutex_t rx_lock;
+
+	/**
+	 * RPMsg buffer reclaimer that contains buffers released by the
+	 * \ref rpmsg_virtio_release_tx_buffer function. Lock-free stack, pushed
+	 * without lock and popped under tx_lock.
+	 */
+	atomic_uintptr_t reclaimer;
+
+	/** Number of tx buffers taken from the shared memory pool, driver side */
+	unsigned int tx_bufs;
+
+	/** Number of senders waiting for a tx buffer of the queue pair */
+	unsigned int tx_waiters;
+
+	/**
+	 * Messages of the rx buffers, indexed by buffer index, to queue them on
+	 * their endpoint for a deferred dispatch or rpmsg_recv_nocopy()
+	 */
+	struct rpmsg_rx_msg *rx_msgs;
+
+	/** Whether the rx notifications are disabled for rpmsg_virtio_poll() */
+	bool rx_polling;
+
+	/** Copy of the device notify_max_bufs for the tx side, under tx_lock */
+	uint16_t tx_max_bufs;
+
+	/** Copy of the device notify_max_bufs for the rx side, under rx_lock */
+	uint16_t rx_max_bufs;
+
+	/** Bytes of tx buffers flushed from the data cache, under tx_lock */
+	uint64_t tx_flushed;
+
+	/** Bytes of rx buffers invalidated in the data cache, under rx_lock */
+	uint64_t rx_invalidated;
+};
+
 /** @brief Representation of a RPMsg device based on virtio */
 struct rpmsg_virtio_device {
 	/** RPMsg device */
@@ -81,29 +232,71 @@ struct rpmsg_virtio_device {
 	/** Pointer to the virtio device */
 	struct virtio_device *vdev;
 
-	/** Pointer to receive virtqueue */
+	/** Pointer to receive virtqueue of the first queue pair */
 	struct virtqueue *rvq;
 
-	/** Pointer to send virtqueue */
+	/** Pointer to send virtqueue of the first queue pair */
 	struct virtqueue *svq;
 
+	/** Rx/tx virtqueue pairs, one per pair of vrings of the virtio device */
+	struct rpmsg_virtio_queue queues[RPMSG_VIRTIO_MAX_QUEUES];
+
+	/** Number of queue pairs in use */
+	unsigned int num_queues;
+
 	/** Pointer to the shared buffer I/O region */
 	struct metal_io_region *shbuf_io;
 
 	/** Pointer to the shared buffers pool */
 	struct rpmsg_virtio_shm_pool *shpool;
 
-	/**
-	 * RPMsg buffer reclaimer that contains buffers released by the
-	 * \ref rpmsg_virtio_release_tx_buffer function
-	 */
-	struct metal_list reclaimer;
+	/** Pointer to the shared buffers pool of the rx buffers */
+	struct rpmsg_virtio_shm_pool *rx_shpool;
 
 	/**
 	 * Callback handler for rpmsg virtio service, called when service
 	 * can't get tx buffer
 	 */
 	rpmsg_virtio_notify_wait_cb notify_wait_cb;
+
+	/** Callback handler to wait for tx buffers, see rpmsg_virtio_set_tx_wait_cb() */
+	rpmsg_virtio_tx_wait_cb tx_wait_cb;
+
+	/** Callback handler to wake up the senders waiting for tx buffers */
+	rpmsg_virtio_tx_wake_cb tx_wake_cb;
+
+	/** Time a sender waits for a tx buffer, in microseconds */
+	uint32_t tx_timeout_us;
+
+	/** Number of tx messages queued before notifying the remote */
+	unsigned int tx_kick_batch;
+
+	/** Maximum number of messages processed per rx notification, 0 for no limit */
+	int rx_budget;
+
+	/** Callback handler to schedule rx polling, see rpmsg_virtio_set_rx_budget() */
+	rpmsg_virtio_rx_poll_cb rx_poll_cb;
+
+	/**
+	 * Number of buffers per notification under load, 0 for no moderation.
+	 * Under the rpmsg device lock, the queue pairs use their own copies.
+	 */
+	uint16_t notify_max_bufs;
+
+	/** Maximum delay of a moderated notification, in microseconds */
+	uint32_t notify_timeout_us;
+
+	/** Callback handler to start the moderation timer */
+	rpmsg_virtio_notify_timer_cb notify_timer_cb;
+
+	/** Whether the moderation timer is running */
+	bool notify_timer_armed;
+
+	/** Callback handler to wake up the dispatch workers, NULL to dispatch inline */
+	rpmsg_virtio_dispatch_cb dispatch_cb;
+
+	/** Endpoints with queued messages waiting for a worker */
+	struct metal_list rx_ready;
 };
 
 #define RPMSG_REMOTE	VIRTIO_DEV_DEVICE
@@ -121,6 +314,86 @@ static inline void rpmsg_virtio_set_wait_cb(struct rpmsg_virtio_device *rvdev,
 	rvdev->notify_wait_cb = notify_wait_cb;
 }
 
+/**
+ * @brief Set the callbacks to wait for the remote to release tx buffers.
+ *
+ * When no tx buffer is available, the sender enables the tx-done
+ * notifications of the remote and calls wait_cb, which blocks until wake_cb
+ * is called from the notification handler or the timeout elapses. They are
+ * typically implemented with a semaphore, so that a wake-up happening before
+ * the wait is not lost. wait_cb returns RPMSG_SUCCESS when woken up, an error
+ * code on timeout. Before returning, wait_cb subtracts the time it waited from
+ * *timeout_us: a sender woken up without getting a buffer waits again only for
+ * the time left, so that it never waits longer than the tx timeout in total.
+ *
+ * These callbacks take precedence over the notify_wait_cb callback.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device.
+ * @param wait_cb	Callback handler to wait for tx buffers.
+ * @param wake_cb	Callback handler to wake up the waiting senders.
+ */
+static inline void rpmsg_virtio_set_tx_wait_cb(struct rpmsg_virtio_device *rvdev,
+					       rpmsg_virtio_tx_wait_cb wait_cb,
+					       rpmsg_virtio_tx_wake_cb wake_cb)
+{
+	rvdev->tx_wait_cb = wait_cb;
+	rvdev->tx_wake_cb = wake_cb;
+}
+
+/**
+ * @brief Set the time a sender waits for a tx buffer.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device.
+ * @param timeout_us	Timeout in microseconds, 15 seconds by default.
+ */
+static inline void rpmsg_virtio_set_tx_timeout(struct rpmsg_virtio_device *rvdev,
+					       uint32_t timeout_us)
+{
+	rvdev->tx_timeout_us = timeout_us;
+}
+
+/**
+ * @brief Set the number of tx messages queued before notifying the remote.
+ *
+ * By default the remote is notified of each message sent. With a batch
+ * larger than 1, it is notified once per batch of messages sent on a queue
+ * pair, saving an interrupt per message. The messages left pending at the end
+ * of a burst are notified by rpmsg_flush(), or when the sender runs out of tx
+ * buffers.
+ *
+ * @param rvdev	Pointer to rpmsg virtio device.
+ * @param batch	Number of messages per notification, 0 or 1 to notify each
+ *		message.
+ */
+static inline void
+rpmsg_virtio_set_tx_coalescing(struct rpmsg_virtio_device *rvdev,
+			       unsigned int batch)
+{
+	rvdev->tx_kick_batch = batch;
+}
+
+/**
+ * @brief Set the rx budget, to switch to polling under load.
+ *
+ * By default, an rx notification processes all the messages received. With a
+ * budget, it processes at most budget messages. When the budget is used up,
+ * the rx notifications are disabled and poll_cb is called, to schedule
+ * rpmsg_virtio_poll() calls from a context of lower priority. The
+ * notifications are enabled again by rpmsg_virtio_poll() once the rings are
+ * drained.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device.
+ * @param budget	Maximum number of messages per notification, 0 for no
+ *			limit.
+ * @param poll_cb	Callback handler to schedule the polling, mandatory
+ *			with a budget.
+ *
+ * @return RPMSG_SUCCESS on success, RPMSG_ERR_PARAM if the budget is negative,
+ * or set without poll_cb
+ */
+int rpmsg_virtio_set_rx_budget(struct rpmsg_virtio_device *rvdev, int budget,
+			       rpmsg_virtio_rx_poll_cb poll_cb);
+
 /**
  * @brief Get rpmsg virtio device role.
  *
@@ -207,6 +480,15 @@ int rpmsg_init_vdev(struct rpmsg_virtio_device *rvdev,
  * Sizes of virtio data buffers used by the initialized RPMsg instance are set
  * to values read from the passed configuration structure.
  *
+ * The virtqueues use the packed vring layout if VIRTIO_F_RING_PACKED is set in
+ * the virtio device features, the split layout otherwise.
+ * With VIRTIO_F_IN_ORDER also set, the split virtqueues return the buffers
+ * in the order they were made available, a buffer held by the remote side
+ * delays the return of the ones received after it.
+ *
+ * Each pair of vrings of the virtio device, up to RPMSG_VIRTIO_MAX_QUEUES,
+ * is used as an rx/tx queue pair, see rpmsg_virtio_set_ept_queue().
+ *
  * Remote side:
  * This API will not return until the driver ready is set by the host side.
  * Sizes of virtio data buffers are set by the host side. Values passed in the
@@ -235,9 +517,150 @@ int rpmsg_init_vdev_with_config(struct rpmsg_virtio_device *rvdev,
 				struct rpmsg_virtio_shm_pool *shpool,
 				const struct rpmsg_virtio_config *config);
 
+/**
+ * @brief Bind an endpoint to a queue pair of its rpmsg virtio device
+ *
+ * The messages sent by the endpoint go through the send virtqueue of the
+ * queue pair, so that its traffic is not held up by the endpoints bound to
+ * other queue pairs. Unbound endpoints are spread over the queue pairs
+ * according to their local address. Zero-copy buffers always use the first
+ * queue pair.
+ *
+ * @param ept	Pointer to the rpmsg endpoint, already created
+ * @param qid	Index of the queue pair, or RPMSG_QUEUE_ANY to unbind
+ *
+ * @return RPMSG_SUCCESS on success, otherwise error code
+ */
+int rpmsg_virtio_set_ept_queue(struct rpmsg_endpoint *ept, unsigned int qid);
+
+/**
+ * @brief Process the messages received by an rpmsg virtio device
+ *
+ * Processes at most budget messages over all the queue pairs of the device.
+ * When the rings are drained before the budget is used up, the rx
+ * notifications disabled under load are enabled again.
+ *
+ * @param rdev		Pointer to the rpmsg device
+ * @param budget	Maximum number of messages to process
+ *
+ * @return budget if messages remain and polling has to go on, the number of
+ * messages processed if the rings are drained, negative error code on failure
+ */
+int rpmsg_virtio_poll(struct rpmsg_device *rdev, int budget);
+
+/**
+ * @brief Set the deferred rx dispatch mode of an rpmsg virtio device
+ *
+ * By default, the endpoint callbacks are called from the rx notification
+ * context, so a slow callback delays the messages of all the endpoints.
+ *
+ * In deferred mode, the rx notification only holds the received buffers and
+ * queues them on their endpoint. The callbacks are called by worker threads
+ * of the platform, as many as needed, running rpmsg_virtio_dispatch().
+ * dispatch_cb is called once endpoints have messages waiting, to wake up the
+ * workers. The first time the deferred mode is set, a message descriptor is
+ * allocated for each rx buffer.
+ *
+ * When the deferred mode is left, the messages still queued are delivered
+ * from the calling context before returning, the endpoints a worker is
+ * dispatching are left to that worker.
+ *
+ * @param rvdev		Pointer to the rpmsg virtio device
+ * @param dispatch_cb	Callback handler to wake up the workers, NULL to call
+ *			the endpoint callbacks inline again
+ *
+ * @return RPMSG_SUCCESS on success, otherwise error code:
+ *   - RPMSG_ERR_PARAM on invalid parameter
+ *   - RPMSG_ERR_NO_MEM if the message descriptors cannot be allocated
+ */
+int rpmsg_virtio_set_rx_dispatch(struct rpmsg_virtio_device *rvdev,
+				 rpmsg_virtio_dispatch_cb dispatch_cb);
+
+/**
+ * @brief Dispatch the queued rx messages of an rpmsg virtio device
+ *
+ * Called by the worker threads of the deferred rx dispatch mode. Each worker
+ * takes the next endpoint with queued messages and calls its callback for
+ * them in order, then releases their buffers. An endpoint is dispatched by a
+ * single worker at a time, the other workers take the other endpoints.
+ *
+ * @param rdev		Pointer to the rpmsg device
+ * @param budget	Maximum number of messages to dispatch
+ *
+ * @return budget if messages may remain, the number of messages dispatched
+ * once no endpoint has queued messages, negative error code on failure
+ */
+int rpmsg_virtio_dispatch(struct rpmsg_device *rdev, int budget);
+
+/**
+ * @brief Set the notification moderation policy of an rpmsg virtio device
+ *
+ * Under load, the remote is asked to notify the rx messages and the released
+ * tx buffers only every max_bufs buffers. The messages left behind are
+ * processed at the latest timeout_us later: timer_cb is called to start a
+ * one-shot timer, that has to call rpmsg_virtio_notify_timeout() on expiry.
+ * Once no message arrives during a timer period, the notifications are
+ * requested for each buffer again.
+ *
+ * Moderation requires the VIRTIO_RING_F_EVENT_IDX feature.
+ *
+ * @param rvdev		Pointer to the rpmsg virtio device
+ * @param max_bufs	Number of buffers per notification, 0 or 1 to disable
+ *			the moderation
+ * @param timeout_us	Maximum delay of a notification, in microseconds
+ * @param timer_cb	Callback handler to start the moderation timer
+ *
+ * @return RPMSG_SUCCESS on success, otherwise error code
+ */
+int rpmsg_virtio_set_notify_moderation(struct rpmsg_virtio_device *rvdev,
+				       uint16_t max_bufs, uint32_t timeout_us,
+				       rpmsg_virtio_notify_timer_cb timer_cb);
+
+/**
+ * @brief Handle the expiry of the notification moderation timer
+ *
+ * Processes the rx messages and wakes up the tx buffer waiters left behind by
+ * the moderated notifications.
+ *
+ * @param rdev	Pointer to the rpmsg device
+ */
+void rpmsg_virtio_notify_timeout(struct rpmsg_device *rdev);
+
+/**
+ * @brief Get the notification statistics of an rpmsg virtio device
+ *
+ * @param rdev	Pointer to the rpmsg device
+ * @param stats	Pointer to the statistics to fill
+ *
+ * @return RPMSG_SUCCESS on success, otherwise error code
+ */
+int rpmsg_virtio_get_notify_stats(struct rpmsg_device *rdev,
+				  struct rpmsg_virtio_notify_stats *stats);
+
+/**
+ * @brief Get the buffer cache maintenance statistics of an rpmsg virtio device
+ *
+ * The bytes of the RPMsg buffers flushed and invalidated are only counted when
+ * the cache operations are enabled (WITH_DCACHE), they stay 0 otherwise.
+ * Comparing them with the buffer size times the number of messages gives the
+ * maintenance saved by limiting it to the message length.
+ *
+ * @param rdev	Pointer to the rpmsg device
+ * @param stats	Pointer to the statistics to fill
+ *
+ * @return RPMSG_SUCCESS on success, otherwise error code
+ */
+int rpmsg_virtio_get_cache_stats(struct rpmsg_device *rdev,
+				 struct rpmsg_virtio_cache_stats *stats);
+
 /**
  * @brief Deinitialize rpmsg virtio device
  *
+ * Host side:
+ * The buffers of the virtqueues are returned to the shared memory pool, so
+ * the pool can be passed again to rpmsg_init_vdev(). The rx buffers still
+ * held and the tx buffers still reserved by the application are not.
+ *
  * @param rvdev	Pointer to the rpmsg virtio device
  */
 void rpmsg_deinit_vdev(struct rpmsg_virtio_device *rvdev);
@@ -249,6 +672,8 @@ void rpmsg_deinit_vdev(struct rpmsg_virtio_device *rvdev);
  * The memory assigned to this pool will be dedicated to the RPMsg
  * virtio. This function has to be called before calling rpmsg_init_vdev,
  * to initialize the rpmsg_virtio_shm_pool structure.
+ * A pool initialized before has to be deinitialized first with
+ * rpmsg_virtio_deinit_shm_pool().
  *
  * @param shpool	Pointer to the shared buffers pool structure
  * @param shbuf		Pointer to the beginning of shared buffers
@@ -257,6 +682,17 @@ void rpmsg_deinit_vdev(struct rpmsg_virtio_device *rvdev);
 void rpmsg_virtio_init_shm_pool(struct rpmsg_virtio_shm_pool *shpool,
 				void *shbuf, size_t size);
 
+/**
+ * @brief Deinitialize a shared buffers pool
+ *
+ * The devices using the pool have to be deinitialized first. Once done, the
+ * pool can be initialized again with rpmsg_virtio_init_shm_pool(), e.g. to
+ * reuse its memory after a restart of the virtio device.
+ *
+ * @param shpool	Pointer to the shared buffers pool structure
+ */
+void rpmsg_virtio_deinit_shm_pool(struct rpmsg_virtio_shm_pool *shpool);
+
 /**
  * @brief Get RPMsg device from RPMsg virtio device
  *
@@ -281,6 +717,12 @@ rpmsg_virtio_get_rpmsg_device(struct rpmsg_virtio_device *rvdev)
  * virtio. If you prefer to have other shared buffers allocation,
  * you can implement your rpmsg_virtio_shm_pool_get_buffer function.
  *
+ * The buffers of the same size form a size class, up to
+ * RPMSG_SHM_POOL_NUM_CLASSES. A freed buffer of the class is reused first;
+ * when there is none, a new buffer is taken from the pool memory. A size
+ * without class of its own, once all the classes are used, is served by the
+ * smallest class of larger buffers.
+ *
  * @param shpool	Pointer to the shared buffers pool
  * @param size		Shared buffers total size
  *
@@ -290,6 +732,35 @@ metal_weak void *
 rpmsg_virtio_shm_pool_get_buffer(struct rpmsg_virtio_shm_pool *shpool,
 				 size_t size);
 
+/**
+ * @brief Free a buffer of the shared memory pool
+ *
+ * The buffer is put back in the free list of its size class, to be returned
+ * by a later rpmsg_virtio_shm_pool_get_buffer() call of the same size.
+ * If you implement your own rpmsg_virtio_shm_pool_get_buffer function, you
+ * have to implement this one too.
+ *
+ * @param shpool	Pointer to the shared buffers pool
+ * @param buf		Buffer returned by rpmsg_virtio_shm_pool_get_buffer
+ * @param size		Size the buffer was allocated with
+ */
+metal_weak void
+rpmsg_virtio_shm_pool_free_buffer(struct rpmsg_virtio_shm_pool *shpool,
+				  void *buf, size_t size);
+
+/**
+ * @brief Get the statistics of a size class of the shared memory pool
+ *
+ * @param shpool	Pointer to the shared buffers pool
+ * @param class_idx	Index of the size class, from 0
+ * @param stats		Pointer to the statistics to fill
+ *
+ * @return RPMSG_SUCCESS on success, RPMSG_ERR_PARAM if there is no such class
+ */
+int rpmsg_virtio_shm_pool_get_stats(struct rpmsg_virtio_shm_pool *shpool,
+				    unsigned int class_idx,
+				    struct rpmsg_virtio_shm_pool_stats *stats);
+
 #if defined __cplusplus
 }
 #endif
@@ -424,8 +424,9 @@ static inline int virtio_get_features(struct virtio_device *vdev,
 		return -ENXIO;
 
 	*features = vdev->func->get_features(vdev);
+	/* Keep the feature bits above the 32-bit word, e.g. VIRTIO_F_RING_PACKED */
 	if (VIRTIO_ROLE_IS_DEVICE(vdev))
-		vdev->features = *features;
+		vdev->features = (vdev->features & ~0xFFFFFFFFULL) | *features;
 
 	return 0;
 }
@@ -543,6 +544,26 @@ static inline int virtio_free_buf(struct virtio_device *vdev, void *buf)
 	return 0;
 }
 
+/**
+ * @brief Get the size of the vring memory used by a virtqueue of the device.
+ *
+ * The size depends on the vring layout, split or packed (VIRTIO_F_RING_PACKED).
+ *
+ * @param vdev		Pointer to device structure.
+ * @param num_descs	Number of descriptors of the vring.
+ * @param align		Vring alignment.
+ *
+ * @return Size of the vring in bytes.
+ */
+static inline int virtio_vring_size(struct virtio_device *vdev,
+				    unsigned int num_descs, unsigned long align)
+{
+	if (vdev->features & VIRTIO_F_RING_PACKED)
+		return vring_packed_size(num_descs, align);
+
+	return vring_size(num_descs, align);
+}
+
 /**
  * @brief Check if the virtio device support a specific feature.
  *
@@ -178,10 +178,28 @@ struct vring {
 #define vring_used_event(vr)	((vr)->avail->ring[(vr)->num])
 #define vring_avail_event(vr)	((vr)->used->ring[(vr)->num].event)
 
+/* Cache line size assumed to merge the vring cache operations */
+#ifndef VIRTIO_CACHE_LINE_SIZE
+#define VIRTIO_CACHE_LINE_SIZE		64
+#endif
+
+/*
+ * With VIRTIO_CACHE_LINE_ALIGN, the vring alignment is raised to the cache
+ * line size, so that the areas written by the driver and by the device never
+ * share a cache line. Both sides have to use the same layout.
+ */
+#ifdef VIRTIO_CACHE_LINE_ALIGN
+#define VRING_ALIGN(align) \
+	((align) > VIRTIO_CACHE_LINE_SIZE ? (align) : VIRTIO_CACHE_LINE_SIZE)
+#else
+#define VRING_ALIGN(align)		(align)
+#endif
+
 static inline int vring_size(unsigned int num, unsigned long align)
 {
 	int size;
 
+	align = VRING_ALIGN(align);
 	size = num * sizeof(struct vring_desc);
 	size += sizeof(struct vring_avail) + (num * sizeof(uint16_t)) +
 	    sizeof(uint16_t);
@@ -195,6 +213,7 @@ static inline int vring_size(unsigned int num, unsigned long align)
 static inline void
 vring_init(struct vring *vr, unsigned int num, uint8_t *p, unsigned long align)
 {
+	align = VRING_ALIGN(align);
 	vr->num = num;
 	vr->desc = (struct vring_desc *)p;
 	vr->avail = (struct vring_avail *)(p + num * sizeof(struct vring_desc));
@@ -203,6 +222,101 @@ vring_init(struct vring *vr, unsigned int num, uint8_t *p, unsigned long align)
 	      align - 1) & ~(align - 1));
 }
 
+/* Packed ring descriptor flags: mark a descriptor available or used. */
+#define VRING_PACKED_DESC_F_AVAIL	(1 << 7)
+#define VRING_PACKED_DESC_F_USED	(1 << 15)
+
+/* Packed ring event suppression flags. */
+#define VRING_PACKED_EVENT_FLAG_ENABLE	0x0
+#define VRING_PACKED_EVENT_FLAG_DISABLE	0x1
+#define VRING_PACKED_EVENT_FLAG_DESC	0x2
+
+/* Bit of off_wrap holding the wrap counter of the event descriptor offset. */
+#define VRING_PACKED_EVENT_F_WRAP_CTR	15
+
+/**
+ * @brief Packed ring descriptor.
+ *
+ * In a packed virtqueue, the descriptor is written by the driver to make a
+ * buffer available and overwritten by the device to mark it used, so a
+ * single descriptor slot carries the whole buffer life cycle.
+ */
+METAL_PACKED_BEGIN
+struct vring_packed_desc {
+	/** Buffer address (guest-physical) */
+	uint64_t addr;
+
+	/** Buffer length */
+	uint32_t len;
+
+	/** Buffer ID */
+	uint16_t id;
+
+	/** Flags relevant to the descriptor, including the avail/used bits */
+	uint16_t flags;
+} METAL_PACKED_END;
+
+/** @brief Packed ring event suppression structure. */
+METAL_PACKED_BEGIN
+struct vring_packed_desc_event {
+	/** Descriptor ring change event offset and wrap counter */
+	uint16_t off_wrap;
+
+	/** Descriptor ring change event flags */
+	uint16_t flags;
+} METAL_PACKED_END;
+
+/**
+ * @brief The packed virtqueue layout structure
+ *
+ * |vring          | definition                              | written by
+ * |---------------|---------------------------------------- |-----------
+ * | desc          | struct vring_packed_desc desc[num]      | both
+ * | driver        | struct vring_packed_desc_event          | driver
+ * | pad           | char pad[]                              |
+ * | device        | struct vring_packed_desc_event          | device
+ */
+struct vring_packed {
+	/** The number of descriptors in the ring, always a power of 2 */
+	unsigned int num;
+
+	/** The descriptor ring */
+	struct vring_packed_desc *desc;
+
+	/** Driver event suppression area, controls used buffer notifications */
+	struct vring_packed_desc_event *driver;
+
+	/** Device event suppression area, controls available buffer notifications */
+	struct vring_packed_desc_event *device;
+};
+
+static inline int vring_packed_size(unsigned int num, unsigned long align)
+{
+	int size;
+
+	align = VRING_ALIGN(align);
+	size = num * sizeof(struct vring_packed_desc);
+	size += sizeof(struct vring_packed_desc_event);
+	size = (size + align - 1) & ~(align - 1);
+	size += sizeof(struct vring_packed_desc_event);
+
+	return size;
+}
+
+static inline void
+vring_packed_init(struct vring_packed *vr, unsigned int num, uint8_t *p,
+		  unsigned long align)
+{
+	align = VRING_ALIGN(align);
+	vr->num = num;
+	vr->desc = (struct vring_packed_desc *)p;
+	vr->driver = (struct vring_packed_desc_event *)
+	    (p + num * sizeof(struct vring_packed_desc));
+	vr->device = (struct vring_packed_desc_event *)
+	    (((unsigned long)vr->driver + sizeof(*vr->driver) +
+	      align - 1) & ~(align - 1));
+}
+
 /*
  * The following is used with VIRTIO_RING_F_EVENT_IDX.
  *
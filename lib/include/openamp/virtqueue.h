@@ -48,6 +48,23 @@ extern "C" {
 /* Support to suppress interrupt until specific index is reached. */
 #define VIRTIO_RING_F_EVENT_IDX        (1 << 29)
 
+/*
+ * Support for the packed virtqueue layout. This bit lies above the 32-bit
+ * feature words of the remoteproc resource table, so on such transports it
+ * has to be set in virtio_device::features by both sides before the
+ * virtqueues are created.
+ */
+#define VIRTIO_F_RING_PACKED           (1ULL << 34)
+
+/*
+ * Buffers are used in the order they were made available. The device side
+ * then writes a single used ring element per batch and the driver side finds
+ * the buffers of the batch from the available ring. Like VIRTIO_F_RING_PACKED,
+ * this bit has to be set in virtio_device::features by both sides, it is only
+ * honored by split virtqueues.
+ */
+#define VIRTIO_F_IN_ORDER              (1ULL << 35)
+
 #if defined(VIRTIO_USE_DCACHE)
 #define VRING_FLUSH(x, s)		metal_cache_flush(x, s)
 #define VRING_INVALIDATE(x, s)		metal_cache_invalidate(x, s)
@@ -56,6 +73,17 @@ extern "C" {
 #define VRING_INVALIDATE(x, s)		do { } while (0)
 #endif /* VIRTIO_USE_DCACHE */
 
+#if defined(VIRTIO_USE_DCACHE)
+/** @brief Range of a vring written but not flushed yet. */
+struct vq_dirty_range {
+	/** Start address of the range, equal to end if the range is empty. */
+	uintptr_t start;
+
+	/** End address of the range. */
+	uintptr_t end;
+};
+#endif /* VIRTIO_USE_DCACHE */
+
 /** @brief Buffer descriptor. */
 struct virtqueue_buf {
 	/** Address of the buffer. */
@@ -70,8 +98,18 @@ struct vq_desc_extra {
 	/** Pointer to first descriptor. */
 	void *cookie;
 
-	/** Number of chained descriptors. */
+	/**
+	 * Number of chained descriptors. On the device side of an in-order
+	 * split ring, non-zero once the buffer is consumed and not yet in the
+	 * used ring.
+	 */
 	uint16_t ndescs;
+
+	/** Next free buffer ID, packed ring driver side only. */
+	uint16_t next;
+
+	/** Length of the buffer, packed ring or in-order device side only. */
+	uint32_t len;
 };
 
 /** @brief Local virtio queue to manage a virtio ring for sending or receiving. */
@@ -124,6 +162,62 @@ struct virtqueue {
 	/** Last consumed descriptor in the available table, used by the consumer side. */
 	uint16_t vq_available_idx;
 
+	/** Packed ring layout, used instead of vq_ring if VIRTIO_F_RING_PACKED is set. */
+	struct vring_packed vq_packed_ring;
+
+	/** Packed ring: next descriptor slot to make available, driver side. */
+	uint16_t vq_packed_avail_idx;
+
+	/** Packed ring: next descriptor slot to mark used, device side. */
+	uint16_t vq_packed_used_idx;
+
+	/** Packed ring: wrap counter of the available descriptor slots. */
+	bool vq_packed_avail_wrap;
+
+	/** Packed ring: wrap counter of the used descriptor slots. */
+	bool vq_packed_used_wrap;
+
+	/**
+	 * Indirect descriptor tables, vq_max_indirect entries per buffer ID.
+	 * NULL if the driver side does not use indirect descriptors.
+	 */
+	struct vring_desc *vq_indirect;
+
+	/** Maximum number of descriptors in an indirect table. */
+	uint16_t vq_max_indirect;
+
+	/** Descriptors stay bound to their buffers, see virtqueue_set_fixed_buffers(). */
+	bool vq_fixed;
+
+	/**
+	 * Number of buffers the other side processes before notifying, when
+	 * the callback is enabled. Only honored with VIRTIO_RING_F_EVENT_IDX.
+	 */
+	uint16_t vq_notify_thresh;
+
+	/** Number of notifications sent to the other side. */
+	uint32_t vq_notify_sent;
+
+	/** Number of notifications to the other side suppressed on its request. */
+	uint32_t vq_notify_suppressed;
+
+	/** Number of notifications received from the other side. */
+	uint32_t vq_notify_received;
+
+#if defined(VIRTIO_USE_DCACHE)
+	/** Descriptors written since the last publication, flushed with it. */
+	struct vq_dirty_range vq_dirty_desc;
+
+	/** Split ring slots written since the last publication, flushed with it. */
+	struct vq_dirty_range vq_dirty_ring;
+
+	/**
+	 * Last index published by the other side and read from memory, used.idx
+	 * on the driver side and avail.idx on the device side.
+	 */
+	uint16_t vq_remote_idx;
+#endif
+
 #ifdef VQUEUE_DEBUG
 	/** Debug counter for virtqueue reentrance check. */
 	bool vq_inuse;
@@ -241,6 +335,43 @@ static inline void virtqueue_set_shmem_io(struct virtqueue *vq,
 	vq->shm_io = io;
 }
 
+/**
+ * @internal
+ *
+ * @brief Returns the memory size needed by the indirect descriptor tables.
+ *
+ * @param num_descs	Number of descriptors in the vring
+ * @param max_indirect	Maximum number of descriptors in an indirect table
+ *
+ * @return Size in bytes of the indirect tables
+ */
+static inline size_t virtqueue_indirect_mem_size(uint16_t num_descs,
+						 uint16_t max_indirect)
+{
+	return (size_t)num_descs * max_indirect * sizeof(struct vring_desc);
+}
+
+/**
+ * @internal
+ *
+ * @brief Sets the memory of the indirect descriptor tables, driver side.
+ *
+ * Once set, and if VIRTIO_RING_F_INDIRECT_DESC is negotiated, a buffer list
+ * of 2 to max_indirect entries added with virtqueue_add_buffer() is placed in
+ * an indirect table and only uses one vring descriptor. The memory must be
+ * accessible by the other side through the virtqueue shared memory I/O
+ * region. It must be set while the virtqueue is empty.
+ *
+ * @param vq		Pointer to VirtIO queue control block
+ * @param mem		Indirect tables memory of virtqueue_indirect_mem_size()
+ *			bytes, or NULL to stop using indirect descriptors
+ * @param max_indirect	Maximum number of descriptors in an indirect table
+ *
+ * @return Function status
+ */
+int virtqueue_set_indirect_mem(struct virtqueue *vq, void *mem,
+			       uint16_t max_indirect);
+
 /**
  * @internal
  *
@@ -258,19 +389,113 @@ static inline void virtqueue_set_shmem_io(struct virtqueue *vq,
 int virtqueue_add_buffer(struct virtqueue *vq, struct virtqueue_buf *buf_list,
 			 int readable, int writable, void *cookie);
 
+/**
+ * @internal
+ *
+ * @brief Enqueues a batch of single descriptor buffers in vring for
+ * consumption by other side.
+ *
+ * All the ring slots are written first, then the new available index is
+ * published once for the whole batch.
+ *
+ * @param vq		Pointer to VirtIO queue control block.
+ * @param buf_list	Pointer to an array of num virtqueue buffers.
+ * @param num		Number of buffers to enqueue
+ * @param writable	Non zero if the buffers are writable, readable otherwise
+ * @param cookies	Array of num pointers to hold call back data
+ *
+ * @return Function status
+ */
+int virtqueue_add_buffer_batch(struct virtqueue *vq,
+			       struct virtqueue_buf *buf_list, int num,
+			       int writable, void **cookies);
+
+/**
+ * @internal
+ *
+ * @brief Binds the descriptors of a VirtIO queue to their buffers
+ *
+ * In fixed-buffer mode, the descriptor chains of the used buffers are not
+ * freed: they stay bound to their buffers, and virtqueue_get_buffer() returns
+ * the index of their head descriptor. The buffers are then made available
+ * again with virtqueue_add_fixed_buffer(), which only writes the available
+ * ring, not the descriptors.
+ *
+ * Only supported by the driver side of split virtqueues.
+ *
+ * @param vq	Pointer to VirtIO queue control block
+ * @param fixed	Boolean, enable or disable the fixed-buffer mode
+ *
+ * @return Function status
+ */
+int virtqueue_set_fixed_buffers(struct virtqueue *vq, bool fixed);
+
+/**
+ * @internal
+ *
+ * @brief Makes bound buffers available again in fixed-buffer mode
+ *
+ * The buffers are published to the other side with a single index update.
+ *
+ * @param vq		Pointer to VirtIO queue control block
+ * @param head_idxs	Array of num head descriptor indexes, as returned by
+ *			virtqueue_get_buffer()
+ * @param num		Number of buffers
+ *
+ * @return Function status
+ */
+int virtqueue_add_fixed_buffer_batch(struct virtqueue *vq,
+				     uint16_t *head_idxs, int num);
+
+/**
+ * @internal
+ *
+ * @brief Makes a bound buffer available again in fixed-buffer mode
+ *
+ * @param vq		Pointer to VirtIO queue control block
+ * @param head_idx	Head descriptor index, as returned by
+ *			virtqueue_get_buffer()
+ *
+ * @return Function status
+ */
+int virtqueue_add_fixed_buffer(struct virtqueue *vq, uint16_t head_idx);
+
 /**
  * @internal
  *
  * @brief Returns used buffers from VirtIO queue
  *
+ * With VIRTIO_F_IN_ORDER, the length of a buffer used within a batch is the
+ * length of its head descriptor, only the last buffer of a batch has its
+ * used length.
+ *
  * @param vq	Pointer to VirtIO queue control block
  * @param len	Length of conumed buffer
- * @param idx	Index of the buffer
+ * @param idx	Index of the buffer, index of the head descriptor in
+ *		fixed-buffer mode
  *
  * @return Pointer to used buffer
  */
 void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx);
 
+/**
+ * @internal
+ *
+ * @brief Returns up to num used buffers from VirtIO queue
+ *
+ * The used index is read and ordered once for the whole batch.
+ *
+ * @param vq		Pointer to VirtIO queue control block
+ * @param cookies	Array of num pointers to receive the used buffers
+ * @param lens		Optional array of num lengths of consumed buffers
+ * @param idxs		Optional array of num indexes of the buffers
+ * @param num		Maximum number of buffers to return
+ *
+ * @return Number of used buffers returned
+ */
+int virtqueue_get_buffer_batch(struct virtqueue *vq, void **cookies,
+			       uint32_t *lens, uint16_t *idxs, int num);
+
 /**
  * @internal
  *
@@ -285,6 +510,30 @@ void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx);
 void *virtqueue_get_first_avail_buffer(struct virtqueue *vq, uint16_t *avail_idx,
 				       uint32_t *len);
 
+/**
+ * @internal
+ *
+ * @brief Returns the whole buffer list of the next available buffer
+ *
+ * The descriptor chain is walked whether it sits in the vring or in an
+ * indirect table, so this is the way for the device side to retrieve buffers
+ * added with indirect descriptors.
+ *
+ * @param vq		Pointer to VirtIO queue control block
+ * @param avail_idx	Pointer to the index to give back with
+ *			virtqueue_add_consumed_buffer()
+ * @param buf_list	Array of max buffers to fill
+ * @param max		Maximum number of buffers in buf_list
+ * @param readable	Optional pointer to the number of readable buffers, which
+ *			come first in buf_list
+ *
+ * @return Number of buffers in buf_list, 0 if no buffer is available or a
+ * negative error code
+ */
+int virtqueue_get_avail_buffer_list(struct virtqueue *vq, uint16_t *avail_idx,
+				    struct virtqueue_buf *buf_list, int max,
+				    int *readable);
+
 /**
  * @internal
  *
@@ -324,6 +573,29 @@ void *virtqueue_get_next_avail_buffer(struct virtqueue *vq, uint16_t idx,
 int virtqueue_add_consumed_buffer(struct virtqueue *vq, uint16_t head_idx,
 				  uint32_t len);
 
+/**
+ * @internal
+ *
+ * @brief Returns a batch of consumed buffers back to VirtIO queue
+ *
+ * All the used ring slots are written first, then the new used index is
+ * published once for the whole batch.
+ *
+ * With VIRTIO_F_IN_ORDER, only the last used ring slot of the batch is
+ * written. Buffers consumed ahead of a buffer made available before them are
+ * held back until that buffer is returned too.
+ *
+ * @param vq		Pointer to VirtIO queue control block
+ * @param head_idxs	Array of num indexes of vring desc containing used buffers
+ * @param lens		Array of num lengths of buffers
+ * @param num		Number of buffers to return
+ *
+ * @return Function status
+ */
+int virtqueue_add_consumed_buffer_batch(struct virtqueue *vq,
+					uint16_t *head_idxs, uint32_t *lens,
+					int num);
+
 /**
  * @internal
  *
@@ -344,6 +616,24 @@ void virtqueue_disable_cb(struct virtqueue *vq);
  */
 int virtqueue_enable_cb(struct virtqueue *vq);
 
+/**
+ * @internal
+ *
+ * @brief Sets the notification threshold of the virtqueue
+ *
+ * Once the callback is enabled again with virtqueue_enable_cb(), the other
+ * side is asked to notify only after thresh buffers have been processed,
+ * instead of after each one. The threshold requires the
+ * VIRTIO_RING_F_EVENT_IDX feature, it is ignored otherwise.
+ *
+ * @param vq		Pointer to VirtIO queue control block
+ * @param thresh	Number of buffers per notification, 0 or 1 to be
+ *			notified for each buffer
+ *
+ * @return Function status
+ */
+int virtqueue_set_notify_threshold(struct virtqueue *vq, uint16_t thresh);
+
 /**
  * @internal
  *
@@ -58,7 +58,8 @@ static int rproc_virtio_create_virtqueue(struct virtio_device *vdev,
 
 	if (VIRTIO_ROLE_IS_DRIVER(vdev)) {
 		size_t offset = metal_io_virt_to_offset(vring_info->io, vring_alloc->vaddr);
-		size_t size = vring_size(vring_alloc->num_descs, vring_alloc->align);
+		size_t size = virtio_vring_size(vdev, vring_alloc->num_descs,
+						 vring_alloc->align);
 
 		metal_io_block_set(vring_info->io, offset, 0, size);
 	}
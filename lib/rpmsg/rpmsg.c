@@ -13,6 +13,83 @@
 
 #include "rpmsg_internal.h"
 
+/**
+ * @internal
+ *
+ * @brief Marks a bit of the address bitmap as used.
+ *
+ * The matching bit of the summary bitmap is set when the whole bitmap word
+ * becomes used, so that the allocator can skip it.
+ *
+ * @param rdev	Pointer to the rpmsg device
+ * @param bit	Index of the address in the bitmap
+ */
+static void rpmsg_bitmap_set(struct rpmsg_device *rdev, unsigned int bit)
+{
+	unsigned int word = bit / METAL_BITS_PER_ULONG;
+
+	metal_bitmap_set_bit(rdev->bitmap, bit);
+	if (rdev->bitmap[word] == ~0UL)
+		metal_bitmap_set_bit(rdev->bitmap_full, word);
+}
+
+/**
+ * @internal
+ *
+ * @brief Marks a bit of the address bitmap as free.
+ *
+ * @param rdev	Pointer to the rpmsg device
+ * @param bit	Index of the address in the bitmap
+ */
+static void rpmsg_bitmap_clear(struct rpmsg_device *rdev, unsigned int bit)
+{
+	metal_bitmap_clear_bit(rdev->bitmap, bit);
+	metal_bitmap_clear_bit(rdev->bitmap_full, bit / METAL_BITS_PER_ULONG);
+}
+
+/**
+ * @internal
+ *
+ * @brief Looks for a free bit of the address bitmap in a range.
+ *
+ * The full words, and the groups of full words recorded by a full summary
+ * word, are skipped without being scanned.
+ *
+ * @param rdev	Pointer to the rpmsg device
+ * @param start	First bit of the range
+ * @param end	End of the range (excluded)
+ *
+ * @return Index of the free bit, end if none is found
+ */
+static unsigned int rpmsg_bitmap_find_clear(struct rpmsg_device *rdev,
+					    unsigned int start,
+					    unsigned int end)
+{
+	unsigned int word = start / METAL_BITS_PER_ULONG;
+	unsigned int last, bit;
+
+	while (start < end) {
+		if (!(word % METAL_BITS_PER_ULONG) &&
+		    rdev->bitmap_full[word / METAL_BITS_PER_ULONG] == ~0UL) {
+			word += METAL_BITS_PER_ULONG;
+		} else {
+			if (!metal_bitmap_is_bit_set(rdev->bitmap_full, word)) {
+				last = (word + 1) * METAL_BITS_PER_ULONG;
+				if (last > end)
+					last = end;
+				bit = metal_bitmap_next_clear_bit(rdev->bitmap,
+								  start, last);
+				if (bit < last)
+					return bit;
+			}
+			word++;
+		}
+		start = word * METAL_BITS_PER_ULONG;
+	}
+
+	return end;
+}
+
 /**
  * @internal
  *
@@ -20,23 +97,28 @@
  *
  * This function provides unique 32 bit address.
  *
- * @param bitmap	Bit map for addresses
- * @param size		Size of bitmap
+ * The search starts after the last allocated address and wraps around, so
+ * that a released address is not reused right away.
+ *
+ * @param rdev	Pointer to the rpmsg device
  *
  * @return A unique address
  */
-static uint32_t rpmsg_get_address(unsigned long *bitmap, unsigned int start, int size)
+static uint32_t rpmsg_get_address(struct rpmsg_device *rdev)
 {
-	unsigned int addr = RPMSG_ADDR_ANY;
 	unsigned int nextbit;
 
-	nextbit = metal_bitmap_next_clear_bit(bitmap, start, size);
-	if (nextbit < (uint32_t)size) {
-		addr = RPMSG_RESERVED_ADDRESSES + nextbit;
-		metal_bitmap_set_bit(bitmap, nextbit);
+	nextbit = rpmsg_bitmap_find_clear(rdev, rdev->bitnext,
+					  RPMSG_ADDR_BMP_SIZE);
+	if (nextbit == RPMSG_ADDR_BMP_SIZE) {
+		nextbit = rpmsg_bitmap_find_clear(rdev, 0, rdev->bitnext);
+		if (nextbit == rdev->bitnext)
+			return RPMSG_ADDR_ANY;
 	}
+	rpmsg_bitmap_set(rdev, nextbit);
+	rdev->bitnext = (nextbit + 1) % RPMSG_ADDR_BMP_SIZE;
 
-	return addr;
+	return RPMSG_RESERVED_ADDRESSES + nextbit;
 }
 
 /**
@@ -44,16 +126,14 @@ static uint32_t rpmsg_get_address(unsigned long *bitmap, unsigned int start, int
  *
  * @brief Frees the given address.
  *
- * @param bitmap	Bit map for addresses
- * @param size		Size of bitmap
- * @param addr		Address to free
+ * @param rdev	Pointer to the rpmsg device
+ * @param addr	Address to free
  */
-static void rpmsg_release_address(unsigned long *bitmap, int size,
-				  int addr)
+static void rpmsg_release_address(struct rpmsg_device *rdev, uint32_t addr)
 {
 	addr -= RPMSG_RESERVED_ADDRESSES;
-	if (addr >= 0 && addr < size)
-		metal_bitmap_clear_bit(bitmap, addr);
+	if (addr < RPMSG_ADDR_BMP_SIZE)
+		rpmsg_bitmap_clear(rdev, addr);
 }
 
 /**
@@ -61,17 +141,16 @@ static void rpmsg_release_address(unsigned long *bitmap, int size,
  *
  * @brief Checks whether address is used or free.
  *
- * @param bitmap	Bit map for addresses
- * @param size		Size of bitmap
- * @param addr		Address to free
+ * @param rdev	Pointer to the rpmsg device
+ * @param addr	Address to check
  *
  * @return TRUE/FALSE
  */
-static int rpmsg_is_address_set(unsigned long *bitmap, int size, int addr)
+static int rpmsg_is_address_set(struct rpmsg_device *rdev, uint32_t addr)
 {
 	addr -= RPMSG_RESERVED_ADDRESSES;
-	if (addr >= 0 && addr < size)
-		return metal_bitmap_is_bit_set(bitmap, addr);
+	if (addr < RPMSG_ADDR_BMP_SIZE)
+		return metal_bitmap_is_bit_set(rdev->bitmap, addr);
 	else
 		return RPMSG_ERR_PARAM;
 }
@@ -81,17 +160,16 @@ static int rpmsg_is_address_set(unsigned long *bitmap, int size, int addr)
  *
  * @brief Marks the address as consumed.
  *
- * @param bitmap	Bit map for addresses
- * @param size		Size of bitmap
- * @param addr		Address to free
+ * @param rdev	Pointer to the rpmsg device
+ * @param addr	Address to mark
  *
  * @return 0 on success, otherwise error code
  */
-static int rpmsg_set_address(unsigned long *bitmap, int size, int addr)
+static int rpmsg_set_address(struct rpmsg_device *rdev, uint32_t addr)
 {
 	addr -= RPMSG_RESERVED_ADDRESSES;
-	if (addr >= 0 && addr < size) {
-		metal_bitmap_set_bit(bitmap, addr);
+	if (addr < RPMSG_ADDR_BMP_SIZE) {
+		rpmsg_bitmap_set(rdev, addr);
 		return RPMSG_SUCCESS;
 	} else {
 		return RPMSG_ERR_PARAM;
@@ -129,12 +207,65 @@ int rpmsg_send_offchannel_raw(struct rpmsg_endpoint *ept, uint32_t src,
 	rdev = ept->rdev;
 
 	if (rdev->ops.send_offchannel_raw)
-		return rdev->ops.send_offchannel_raw(rdev, src, dst, data,
+		return rdev->ops.send_offchannel_raw(rdev, ept, src, dst, data,
 						     len, wait);
 
 	return RPMSG_ERR_PARAM;
 }
 
+int rpmsg_sendv_offchannel_raw(struct rpmsg_endpoint *ept, uint32_t src,
+			       uint32_t dst, const struct rpmsg_iovec *iov,
+			       int iovcnt, int wait)
+{
+	struct rpmsg_device *rdev;
+
+	if (!ept || !ept->rdev || !iov || iovcnt <= 0 ||
+	    dst == RPMSG_ADDR_ANY)
+		return RPMSG_ERR_PARAM;
+
+	rdev = ept->rdev;
+
+	if (rdev->ops.sendv_offchannel_raw)
+		return rdev->ops.sendv_offchannel_raw(rdev, ept, src, dst, iov,
+						      iovcnt, wait);
+
+	return RPMSG_EOPNOTSUPP;
+}
+
+int rpmsg_send_offchannel_batch(struct rpmsg_endpoint *ept, uint32_t src,
+				uint32_t dst, const struct rpmsg_iovec *msgs,
+				int num, int wait)
+{
+	struct rpmsg_device *rdev;
+
+	if (!ept || !ept->rdev || !msgs || num <= 0 ||
+	    dst == RPMSG_ADDR_ANY)
+		return RPMSG_ERR_PARAM;
+
+	rdev = ept->rdev;
+
+	if (rdev->ops.send_offchannel_batch)
+		return rdev->ops.send_offchannel_batch(rdev, ept, src, dst,
+						       msgs, num, wait);
+
+	return RPMSG_EOPNOTSUPP;
+}
+
+int rpmsg_flush(struct rpmsg_endpoint *ept)
+{
+	struct rpmsg_device *rdev;
+
+	if (!ept || !ept->rdev)
+		return RPMSG_ERR_PARAM;
+
+	rdev = ept->rdev;
+
+	if (rdev->ops.flush)
+		return rdev->ops.flush(rdev);
+
+	return RPMSG_SUCCESS;
+}
+
 int rpmsg_send_ns_message(struct rpmsg_endpoint *ept, unsigned long flags)
 {
 	struct rpmsg_ns_msg ns_msg;
@@ -148,8 +279,9 @@ int rpmsg_send_ns_message(struct rpmsg_endpoint *ept, unsigned long flags)
 					&ns_msg, sizeof(ns_msg), true);
 	if (ret < 0)
 		return ret;
-	else
-		return RPMSG_SUCCESS;
+
+	/* Do not let the announcement wait for more messages */
+	return rpmsg_flush(ept);
 }
 
 void rpmsg_hold_rx_buffer(struct rpmsg_endpoint *ept, void *rxbuf)
@@ -178,6 +310,23 @@ void rpmsg_release_rx_buffer(struct rpmsg_endpoint *ept, void *rxbuf)
 		rdev->ops.release_rx_buffer(rdev, rxbuf);
 }
 
+int rpmsg_recv_nocopy(struct rpmsg_endpoint *ept, void **data, uint32_t *src,
+		      uint32_t timeout_us)
+{
+	struct rpmsg_device *rdev;
+
+	/* Messages of endpoints with a callback are not queued */
+	if (!ept || !ept->rdev || ept->cb || !data)
+		return RPMSG_ERR_PARAM;
+
+	rdev = ept->rdev;
+
+	if (rdev->ops.recv_nocopy)
+		return rdev->ops.recv_nocopy(rdev, ept, data, src, timeout_us);
+
+	return RPMSG_EOPNOTSUPP;
+}
+
 int rpmsg_release_tx_buffer(struct rpmsg_endpoint *ept, void *buf)
 {
 	struct rpmsg_device *rdev;
@@ -209,6 +358,23 @@ void *rpmsg_get_tx_payload_buffer(struct rpmsg_endpoint *ept,
 	return NULL;
 }
 
+int rpmsg_get_tx_payload_buffers(struct rpmsg_endpoint *ept, void **buffers,
+				 int num, uint32_t *len, int wait)
+{
+	struct rpmsg_device *rdev;
+
+	if (!ept || !ept->rdev || !buffers || num <= 0 || !len)
+		return RPMSG_ERR_PARAM;
+
+	rdev = ept->rdev;
+
+	if (rdev->ops.get_tx_payload_buffers)
+		return rdev->ops.get_tx_payload_buffers(rdev, buffers, num,
+							len, wait);
+
+	return RPMSG_EOPNOTSUPP;
+}
+
 int rpmsg_get_tx_buffer_size(struct rpmsg_endpoint *ept)
 {
 	struct rpmsg_device *rdev;
@@ -256,47 +422,187 @@ int rpmsg_send_offchannel_nocopy(struct rpmsg_endpoint *ept, uint32_t src,
 	return RPMSG_ERR_PARAM;
 }
 
+int rpmsg_send_offchannel_nocopy_batch(struct rpmsg_endpoint *ept,
+				       uint32_t src, uint32_t dst,
+				       const struct rpmsg_iovec *msgs, int num)
+{
+	struct rpmsg_device *rdev;
+	int i;
+
+	if (!ept || !ept->rdev || !msgs || num <= 0 ||
+	    dst == RPMSG_ADDR_ANY)
+		return RPMSG_ERR_PARAM;
+
+	for (i = 0; i < num; i++) {
+		if (!msgs[i].base)
+			return RPMSG_ERR_PARAM;
+	}
+
+	rdev = ept->rdev;
+
+	if (rdev->ops.send_offchannel_nocopy_batch)
+		return rdev->ops.send_offchannel_nocopy_batch(rdev, src, dst,
+							      msgs, num);
+
+	return RPMSG_EOPNOTSUPP;
+}
+
+/**
+ * @internal
+ *
+ * @brief Get the address hash bucket of an endpoint
+ *
+ * Dynamic addresses are allocated consecutively, so the low bits of the
+ * address spread them evenly over the buckets.
+ *
+ * @param addr	Local address of the endpoint
+ *
+ * @return Index of the bucket
+ */
+static unsigned int rpmsg_addr_hash(uint32_t addr)
+{
+	return addr & (RPMSG_EPT_HASH_SIZE - 1);
+}
+
+/**
+ * @internal
+ *
+ * @brief Get the name hash bucket of an endpoint (FNV-1a)
+ *
+ * @param name	Name of the endpoint
+ *
+ * @return Index of the bucket
+ */
+static unsigned int rpmsg_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+	unsigned int i;
+
+	for (i = 0; i < RPMSG_NAME_SIZE && name[i]; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619U;
+	}
+
+	return hash & (RPMSG_EPT_HASH_SIZE - 1);
+}
+
 struct rpmsg_endpoint *rpmsg_get_endpoint(struct rpmsg_device *rdev,
 					  const char *name, uint32_t addr,
 					  uint32_t dest_addr)
 {
+	struct rpmsg_endpoint *addr_ept = NULL, *ept;
 	struct metal_list *node;
-	struct rpmsg_endpoint *ept;
-
-	metal_list_for_each(&rdev->endpoints, node) {
-		int name_match = 0;
 
-		ept = metal_container_of(node, struct rpmsg_endpoint, node);
-		/* try to get by local address only */
-		if (addr != RPMSG_ADDR_ANY && ept->addr == addr)
-			return ept;
-		/* else use name service and destination address */
-		if (name)
-			name_match = !strncmp(ept->name, name,
-					      sizeof(ept->name));
-		if (!name || !name_match)
+	/* try to get by local address only */
+	if (addr != RPMSG_ADDR_ANY) {
+		ept = rdev->addr_hash[rpmsg_addr_hash(addr)];
+		for (; ept; ept = ept->addr_next) {
+			if (ept->addr == addr) {
+				addr_ept = ept;
+				break;
+			}
+		}
+	}
+	if (!name)
+		return addr_ept;
+
+	/*
+	 * else use name service and destination address, the hash chains
+	 * keep the registration order
+	 */
+	ept = rdev->name_hash[rpmsg_name_hash(name)];
+	for (; ept; ept = ept->name_next) {
+		if (strncmp(ept->name, name, sizeof(ept->name)))
 			continue;
 		/* destination address is known, equal to ept remote address */
 		if (dest_addr != RPMSG_ADDR_ANY && ept->dest_addr == dest_addr)
-			return ept;
+			break;
 		/* ept is registered but not associated to remote ept */
 		if (addr == RPMSG_ADDR_ANY && ept->dest_addr == RPMSG_ADDR_ANY)
+			break;
+	}
+	if (!ept || !addr_ept || ept == addr_ept)
+		return ept ? ept : addr_ept;
+
+	/* Both match, the first registered endpoint wins */
+	metal_list_for_each(&rdev->endpoints, node) {
+		if (node == &addr_ept->node)
+			return addr_ept;
+		if (node == &ept->node)
 			return ept;
 	}
 	return NULL;
 }
 
+/**
+ * @internal
+ *
+ * @brief Releases the rx buffers queued on an endpoint being unregistered
+ *
+ * Each queued message holds an endpoint reference, dropped with its buffer.
+ *
+ * @param rdev	Pointer to rpmsg device
+ * @param ept	Pointer to rpmsg endpoint
+ * @param msgs	Messages removed from the endpoint queue
+ */
+static void rpmsg_release_rx_msgs(struct rpmsg_device *rdev,
+				  struct rpmsg_endpoint *ept,
+				  struct metal_list *msgs)
+{
+	struct rpmsg_rx_msg *msg;
+	struct metal_list *node;
+
+	while ((node = metal_list_first(msgs))) {
+		metal_list_del(node);
+		msg = metal_container_of(node, struct rpmsg_rx_msg, node);
+		rdev->ops.release_rx_buffer(rdev, RPMSG_LOCATE_DATA(msg->hdr));
+
+		metal_mutex_acquire(&rdev->lock);
+		rpmsg_ept_decref(ept);
+		metal_mutex_release(&rdev->lock);
+	}
+}
+
 static void rpmsg_unregister_endpoint(struct rpmsg_endpoint *ept)
 {
 	struct rpmsg_device *rdev = ept->rdev;
+	struct rpmsg_endpoint **pprev;
+	struct metal_list msgs, *node;
 
+	metal_list_init(&msgs);
 	metal_mutex_acquire(&rdev->lock);
 	if (ept->addr != RPMSG_ADDR_ANY)
-		rpmsg_release_address(rdev->bitmap, RPMSG_ADDR_BMP_SIZE,
-				      ept->addr);
+		rpmsg_release_address(rdev, ept->addr);
 	metal_list_del(&ept->node);
+	for (pprev = &rdev->addr_hash[rpmsg_addr_hash(ept->addr)]; *pprev;
+	     pprev = &(*pprev)->addr_next) {
+		if (*pprev == ept) {
+			*pprev = ept->addr_next;
+			break;
+		}
+	}
+	for (pprev = &rdev->name_hash[rpmsg_name_hash(ept->name)]; *pprev;
+	     pprev = &(*pprev)->name_next) {
+		if (*pprev == ept) {
+			*pprev = ept->name_next;
+			break;
+		}
+	}
+	/* Messages queued and not dispatched yet are dropped */
+	if (ept->rx_ready) {
+		metal_list_del(&ept->rx_node);
+		ept->rx_ready = false;
+	}
+	while ((node = metal_list_first(&ept->rx_msgs))) {
+		metal_list_del(node);
+		metal_list_add_tail(&msgs, node);
+	}
 	rpmsg_ept_decref(ept);
 	metal_mutex_release(&rdev->lock);
+
+	rpmsg_release_rx_msgs(rdev, ept, &msgs);
+	metal_mutex_deinit(&ept->frag_rx_lock);
+	metal_mutex_deinit(&ept->frag_tx_lock);
 }
 
 void rpmsg_register_endpoint(struct rpmsg_device *rdev,
@@ -306,19 +612,46 @@ void rpmsg_register_endpoint(struct rpmsg_device *rdev,
 			     rpmsg_ept_cb cb,
 			     rpmsg_ns_unbind_cb ns_unbind_cb, void *priv)
 {
+	struct rpmsg_endpoint **pprev;
+
 	if (name)
 		(void)safe_strcpy(ept->name, sizeof(ept->name), name, RPMSG_NAME_SIZE);
 	else
 		ept->name[0] = 0;
 
 	ept->refcnt = 1;
+	ept->queue = RPMSG_QUEUE_ANY;
 	ept->addr = src;
 	ept->dest_addr = dest;
 	ept->cb = cb;
 	ept->ns_unbind_cb = ns_unbind_cb;
 	ept->priv = priv;
+	ept->frag = false;
+	ept->frag_valid = false;
+	ept->frag_buf = NULL;
+	ept->frag_size = 0;
+	ept->frag_len = 0;
+	ept->frag_src = RPMSG_ADDR_ANY;
+	metal_mutex_init(&ept->frag_tx_lock);
+	metal_mutex_init(&ept->frag_rx_lock);
+	ept->batch_cb = NULL;
+	metal_list_init(&ept->rx_msgs);
+	ept->rx_ready = false;
+	ept->rx_running = false;
 	ept->rdev = rdev;
 	metal_list_add_tail(&rdev->endpoints, &ept->node);
+
+	/* Append to the hash chains to keep the registration order on lookup */
+	ept->addr_next = NULL;
+	for (pprev = &rdev->addr_hash[rpmsg_addr_hash(src)]; *pprev;
+	     pprev = &(*pprev)->addr_next)
+		;
+	*pprev = ept;
+	ept->name_next = NULL;
+	for (pprev = &rdev->name_hash[rpmsg_name_hash(ept->name)]; *pprev;
+	     pprev = &(*pprev)->name_next)
+		;
+	*pprev = ept;
 }
 
 int rpmsg_create_ept(struct rpmsg_endpoint *ept, struct rpmsg_device *rdev,
@@ -328,24 +661,30 @@ int rpmsg_create_ept(struct rpmsg_endpoint *ept, struct rpmsg_device *rdev,
 	int status = RPMSG_SUCCESS;
 	uint32_t addr = src;
 
-	if (!ept || !rdev || !cb)
+	if (!ept || !rdev)
 		return RPMSG_ERR_PARAM;
 
+	/* Endpoints without callback are read with rpmsg_recv_nocopy() */
+	if (!cb) {
+		if (!rdev->ops.enable_recv_nocopy)
+			return RPMSG_EOPNOTSUPP;
+		status = rdev->ops.enable_recv_nocopy(rdev);
+		if (status)
+			return status;
+	}
+
 	metal_mutex_acquire(&rdev->lock);
 	if (src == RPMSG_ADDR_ANY) {
-		addr = rpmsg_get_address(rdev->bitmap, rdev->bitnext, RPMSG_ADDR_BMP_SIZE);
+		addr = rpmsg_get_address(rdev);
 		if (addr == RPMSG_ADDR_ANY) {
 			status = RPMSG_ERR_ADDR;
 			goto ret_status;
 		}
-		rdev->bitnext = (addr + 1) % RPMSG_ADDR_BMP_SIZE;
 	} else if (src >= RPMSG_RESERVED_ADDRESSES) {
-		status = rpmsg_is_address_set(rdev->bitmap,
-					      RPMSG_ADDR_BMP_SIZE, src);
+		status = rpmsg_is_address_set(rdev, src);
 		if (!status) {
 			/* Mark the address as used in the address bitmap. */
-			rpmsg_set_address(rdev->bitmap, RPMSG_ADDR_BMP_SIZE,
-					  src);
+			rpmsg_set_address(rdev, src);
 		} else if (status > 0) {
 			status = RPMSG_ERR_ADDR;
 			goto ret_status;
@@ -390,3 +729,46 @@ void rpmsg_destroy_ept(struct rpmsg_endpoint *ept)
 		(void)rpmsg_send_ns_message(ept, RPMSG_NS_DESTROY);
 	rpmsg_unregister_endpoint(ept);
 }
+
+int rpmsg_enable_fragmentation(struct rpmsg_endpoint *ept, void *rxbuf,
+			       size_t size)
+{
+	struct rpmsg_device *rdev;
+
+	if (!ept || !ept->rdev || (rxbuf && !size))
+		return RPMSG_ERR_PARAM;
+
+	rdev = ept->rdev;
+	if (!rdev->support_frag)
+		return RPMSG_EOPNOTSUPP;
+
+	metal_mutex_acquire(&ept->frag_rx_lock);
+	ept->frag_valid = false;
+	ept->frag_buf = rxbuf;
+	ept->frag_size = rxbuf ? size : 0;
+	ept->frag_len = 0;
+	metal_mutex_release(&ept->frag_rx_lock);
+
+	metal_mutex_acquire(&rdev->lock);
+	ept->frag = true;
+	metal_mutex_release(&rdev->lock);
+
+	return RPMSG_SUCCESS;
+}
+
+int rpmsg_set_ept_batch_cb(struct rpmsg_endpoint *ept,
+			   rpmsg_ept_batch_cb batch_cb)
+{
+	struct rpmsg_device *rdev;
+
+	if (!ept || !ept->rdev)
+		return RPMSG_ERR_PARAM;
+
+	rdev = ept->rdev;
+
+	metal_mutex_acquire(&rdev->lock);
+	ept->batch_cb = batch_cb;
+	metal_mutex_release(&rdev->lock);
+
+	return RPMSG_SUCCESS;
+}
@@ -29,8 +29,18 @@ extern "C" {
 #endif
 
 /* Mask to get the rpmsg buffer held counter from rpmsg_hdr reserved field */
-#define RPMSG_BUF_HELD_SHIFT 16
-#define RPMSG_BUF_HELD_MASK  (0xFFFFU << RPMSG_BUF_HELD_SHIFT)
+#define RPMSG_BUF_HELD_SHIFT 24
+#define RPMSG_BUF_HELD_MASK  (0xFFU << RPMSG_BUF_HELD_SHIFT)
+#define RPMSG_BUF_HELD_MAX   0xFFU
+
+/* Mask to get the rpmsg buffer queue pair from rpmsg_hdr reserved field */
+#define RPMSG_BUF_QUEUE_SHIFT 16
+#define RPMSG_BUF_QUEUE_MASK  (0xFFU << RPMSG_BUF_QUEUE_SHIFT)
+
+/* Flags of the rpmsg_hdr flags field for the fragmented messages */
+#define RPMSG_HDR_F_FRAG	(1U << 0) /* Fragment of a larger message */
+#define RPMSG_HDR_F_FRAG_FIRST	(1U << 1) /* First fragment of the message */
+#define RPMSG_HDR_F_FRAG_LAST	(1U << 2) /* Last fragment of the message */
 
 #define RPMSG_LOCATE_HDR(p) \
 	((struct rpmsg_hdr *)((unsigned char *)(p) - sizeof(struct rpmsg_hdr)))
@@ -90,6 +100,15 @@ struct rpmsg_ns_msg {
 	uint32_t flags;
 } METAL_PACKED_END;
 
+/** @brief Received message queued on its endpoint, see rpmsg_endpoint::rx_msgs */
+struct rpmsg_rx_msg {
+	/** Node in the queue of the endpoint */
+	struct metal_list node;
+
+	/** Header of the held rx buffer */
+	struct rpmsg_hdr *hdr;
+};
+
 int rpmsg_send_ns_message(struct rpmsg_endpoint *ept, unsigned long flags);
 
 struct rpmsg_endpoint *rpmsg_get_endpoint(struct rpmsg_device *rvdev,
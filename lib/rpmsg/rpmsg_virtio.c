@@ -17,6 +17,7 @@
 
 #include "rpmsg_internal.h"
 
+/* Number of vrings of an rx/tx queue pair */
 #define RPMSG_NUM_VRINGS                        2
 
 /* Total tick count for 15secs - 1usec tick. */
@@ -25,6 +26,9 @@
 /* Time to wait - In multiple of 1 msecs. */
 #define RPMSG_TICKS_PER_INTERVAL                1000
 
+/* Maximum number of buffers placed on a virtqueue in one go. */
+#define RPMSG_VIRTIO_BATCH_SIZE                 16
+
 /*
  * Get the buffer held counter value.
  * If 0 the buffer can be released
@@ -42,7 +46,15 @@
 
 /* Get the buffer index */
 #define RPMSG_BUF_INDEX(rphdr)                  \
-	((uint16_t)((rp_hdr)->reserved & ~RPMSG_BUF_HELD_MASK))
+	((uint16_t)((rphdr)->reserved & ~(RPMSG_BUF_HELD_MASK | RPMSG_BUF_QUEUE_MASK)))
+
+/* Get the index of the queue pair the buffer belongs to */
+#define RPMSG_BUF_QUEUE(rphdr)                  \
+	(((rphdr)->reserved & RPMSG_BUF_QUEUE_MASK) >> RPMSG_BUF_QUEUE_SHIFT)
+
+/* Reserved field value of a buffer of queue pair qid, with no holder */
+#define RPMSG_BUF_RESERVED(idx, qid)            \
+	((uint32_t)(idx) | ((uint32_t)(qid) << RPMSG_BUF_QUEUE_SHIFT))
 
 /**
  * struct vbuff_reclaimer_t - vring buffer recycler
@@ -50,14 +62,28 @@
  * This structure is used by the rpmsg virtio to store unused virtio buffer, as the
  * virtqueue structure has been already updated and memory allocated.
  *
- * @param node	node in reclaimer list.
+ * @param next	next buffer in the reclaimer stack.
  * @param idx	virtio descriptor index containing the buffer information.
  */
 struct vbuff_reclaimer_t {
-	struct metal_list node;
+	struct vbuff_reclaimer_t *next;
 	uint16_t idx;
 };
 
+/*
+ * Shared memory pool buffers never share a cache line in the aligned layout.
+ * They are at least pointer aligned, as a free buffer stores the link to the
+ * next one of its class.
+ */
+#ifdef VIRTIO_CACHE_LINE_ALIGN
+#define RPMSG_SHM_POOL_ALIGNMENT	VIRTIO_CACHE_LINE_SIZE
+#else
+#define RPMSG_SHM_POOL_ALIGNMENT	sizeof(void *)
+#endif
+#define RPMSG_SHM_POOL_ALIGN(size) \
+	(((size) + RPMSG_SHM_POOL_ALIGNMENT - 1) & \
+	 ~((size_t)RPMSG_SHM_POOL_ALIGNMENT - 1))
+
 /* Default configuration */
 #if VIRTIO_ENABLED(VIRTIO_DRIVER_SUPPORT)
 #define RPMSG_VIRTIO_DEFAULT_CONFIG                \
@@ -71,29 +97,295 @@ struct vbuff_reclaimer_t {
 #endif
 
 #if VIRTIO_ENABLED(VIRTIO_DRIVER_SUPPORT)
+/**
+ * @internal
+ *
+ * @brief Gets the size class of a shared memory pool for a buffer size.
+ *
+ * The class with the same buffer size is used, else a new class is created
+ * if there is room for it, else the smallest class with larger buffers is
+ * used. Classes are never removed, so a size is always mapped to the same
+ * class.
+ *
+ * @param shpool	Pointer to the shared buffers pool
+ * @param size		Size of the buffer
+ * @param create	Whether a new class can be created for the size
+ *
+ * @return Pointer to the class, NULL if no class can hold the buffer
+ */
+static struct rpmsg_virtio_shm_pool_class *
+rpmsg_virtio_shm_pool_class(struct rpmsg_virtio_shm_pool *shpool, size_t size,
+			    bool create)
+{
+	struct rpmsg_virtio_shm_pool_class *cls, *best = NULL;
+	unsigned int i;
+
+	for (i = 0; i < shpool->num_classes; i++) {
+		cls = &shpool->classes[i];
+		if (cls->stats.size == size)
+			return cls;
+		if (cls->stats.size > size &&
+		    (!best || cls->stats.size < best->stats.size))
+			best = cls;
+	}
+
+	if (create && shpool->num_classes < RPMSG_SHM_POOL_NUM_CLASSES) {
+		cls = &shpool->classes[shpool->num_classes++];
+		memset(cls, 0, sizeof(*cls));
+		cls->stats.size = size;
+		return cls;
+	}
+
+	return best;
+}
+
 metal_weak void *
 rpmsg_virtio_shm_pool_get_buffer(struct rpmsg_virtio_shm_pool *shpool,
 				 size_t size)
 {
-	void *buffer;
+	struct rpmsg_virtio_shm_pool_class *cls;
+	void *buffer = NULL;
+	size_t stride;
 
-	if (!shpool || size == 0 || shpool->avail < size)
+	if (!shpool || size == 0)
 		return NULL;
-	buffer = (char *)shpool->base + shpool->size - shpool->avail;
-	shpool->avail -= size;
 
+	metal_mutex_acquire(&shpool->lock);
+	cls = rpmsg_virtio_shm_pool_class(shpool, size, true);
+	if (!cls)
+		goto out;
+
+	stride = RPMSG_SHM_POOL_ALIGN(cls->stats.size);
+	if (cls->free_list) {
+		buffer = cls->free_list;
+		cls->free_list = *(void **)buffer;
+	} else if (shpool->avail >= stride) {
+		buffer = (char *)shpool->base + shpool->size - shpool->avail;
+		shpool->avail -= stride;
+		cls->stats.total++;
+	} else {
+		cls->stats.failed++;
+		goto out;
+	}
+
+	cls->stats.used++;
+	if (cls->stats.used > cls->stats.peak)
+		cls->stats.peak = cls->stats.used;
+
+out:
+	metal_mutex_release(&shpool->lock);
 	return buffer;
 }
+
+metal_weak void
+rpmsg_virtio_shm_pool_free_buffer(struct rpmsg_virtio_shm_pool *shpool,
+				  void *buf, size_t size)
+{
+	struct rpmsg_virtio_shm_pool_class *cls;
+	char *base;
+
+	if (!shpool || !buf || size == 0)
+		return;
+
+	metal_mutex_acquire(&shpool->lock);
+	/* Only the carved part of the pool holds buffers */
+	base = shpool->base;
+	if ((char *)buf < base ||
+	    (char *)buf >= base + shpool->size - shpool->avail)
+		cls = NULL;
+	else
+		cls = rpmsg_virtio_shm_pool_class(shpool, size, false);
+	if (cls && cls->stats.used) {
+		*(void **)buf = cls->free_list;
+		cls->free_list = buf;
+		cls->stats.used--;
+	}
+	metal_mutex_release(&shpool->lock);
+}
 #endif
 
+int rpmsg_virtio_shm_pool_get_stats(struct rpmsg_virtio_shm_pool *shpool,
+				    unsigned int class_idx,
+				    struct rpmsg_virtio_shm_pool_stats *stats)
+{
+	int status = RPMSG_SUCCESS;
+
+	if (!shpool || !stats)
+		return RPMSG_ERR_PARAM;
+
+	metal_mutex_acquire(&shpool->lock);
+	if (class_idx < shpool->num_classes)
+		*stats = shpool->classes[class_idx].stats;
+	else
+		status = RPMSG_ERR_PARAM;
+	metal_mutex_release(&shpool->lock);
+
+	return status;
+}
+
 void rpmsg_virtio_init_shm_pool(struct rpmsg_virtio_shm_pool *shpool,
 				void *shb, size_t size)
 {
+	size_t pad;
+
 	if (!shpool || !shb || size == 0)
 		return;
+	pad = RPMSG_SHM_POOL_ALIGN((uintptr_t)shb) - (uintptr_t)shb;
+	if (pad >= size)
+		return;
+	shb = (char *)shb + pad;
+	size -= pad;
 	shpool->base = shb;
 	shpool->size = size;
 	shpool->avail = size;
+	shpool->num_classes = 0;
+	metal_mutex_init(&shpool->lock);
+}
+
+void rpmsg_virtio_deinit_shm_pool(struct rpmsg_virtio_shm_pool *shpool)
+{
+	if (!shpool || !shpool->base)
+		return;
+
+	metal_mutex_deinit(&shpool->lock);
+	shpool->base = NULL;
+	shpool->size = 0;
+	shpool->avail = 0;
+	shpool->num_classes = 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Fills the receive virtqueue of a queue pair with empty buffers.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device
+ * @param queue		Queue pair to fill
+ * @param shpool	Shared memory pool to take the buffers from
+ *
+ * @return Status of function execution
+ */
+static int rpmsg_virtio_fill_rx_queue(struct rpmsg_virtio_device *rvdev,
+				      struct rpmsg_virtio_queue *queue,
+				      struct rpmsg_virtio_shm_pool *shpool)
+{
+	struct metal_io_region *shm_io = rvdev->shbuf_io;
+	struct virtqueue_buf vqbuf[RPMSG_VIRTIO_BATCH_SIZE];
+	void *buffers[RPMSG_VIRTIO_BATCH_SIZE];
+	unsigned int idx, num, i;
+	int status;
+
+	for (idx = 0; idx < queue->rvq->vq_nentries; idx += num) {
+		num = metal_min(queue->rvq->vq_nentries - idx,
+				RPMSG_VIRTIO_BATCH_SIZE);
+		for (i = 0; i < num; i++) {
+			/* Initialize TX virtqueue buffers for remote device */
+			buffers[i] = rpmsg_virtio_shm_pool_get_buffer(shpool,
+					rvdev->config.r2h_buf_size);
+			if (!buffers[i]) {
+				/* Only the buffers added are freed on error */
+				while (i--)
+					rpmsg_virtio_shm_pool_free_buffer(shpool,
+							buffers[i],
+							rvdev->config.r2h_buf_size);
+				return RPMSG_ERR_NO_BUFF;
+			}
+
+			vqbuf[i].buf = buffers[i];
+			vqbuf[i].len = rvdev->config.r2h_buf_size;
+
+			metal_io_block_set(shm_io,
+					   metal_io_virt_to_offset(shm_io,
+								   buffers[i]),
+					   0x00, rvdev->config.r2h_buf_size);
+		}
+
+		status = virtqueue_add_buffer_batch(queue->rvq, vqbuf, num, 1,
+						    buffers);
+		if (status != RPMSG_SUCCESS) {
+			/* The batch is not in the virtqueue, free it here */
+			for (i = 0; i < num; i++)
+				rpmsg_virtio_shm_pool_free_buffer(shpool,
+						buffers[i],
+						rvdev->config.r2h_buf_size);
+			return status;
+		}
+	}
+
+	/*
+	 * The rx buffers never change, bind them to their descriptors so that
+	 * only the available ring is written when they are given back. Packed
+	 * rings rewrite their descriptors anyway.
+	 */
+	(void)virtqueue_set_fixed_buffers(queue->rvq, true);
+
+	return RPMSG_SUCCESS;
+}
+
+/**
+ * @internal
+ *
+ * @brief Gets the number of bytes of a buffer used by its message.
+ *
+ * Cache maintenance is limited to these bytes, rather than the whole buffer.
+ *
+ * @param rp_hdr	Pointer to the rpmsg header of the buffer
+ * @param len		Buffer length
+ *
+ * @return Size of the header and payload, bounded by the buffer length
+ */
+static inline uint32_t rpmsg_virtio_msg_len(struct rpmsg_hdr *rp_hdr,
+					    uint32_t len)
+{
+	return metal_min(len, sizeof(*rp_hdr) + rp_hdr->len);
+}
+
+/**
+ * @internal
+ *
+ * @brief Flushes a tx buffer from the data cache and accounts for it.
+ *
+ * Called under the tx lock of the queue pair.
+ *
+ * @param queue	Queue pair the buffer belongs to
+ * @param buf	Start of the area to flush
+ * @param len	Length of the area to flush
+ */
+static inline void rpmsg_virtio_buf_flush(struct rpmsg_virtio_queue *queue,
+					  void *buf, uint32_t len)
+{
+	BUFFER_FLUSH(buf, len);
+#if defined(VIRTIO_USE_DCACHE)
+	queue->tx_flushed += len;
+#else
+	(void)queue;
+	(void)buf;
+	(void)len;
+#endif
+}
+
+/**
+ * @internal
+ *
+ * @brief Invalidates an rx buffer in the data cache and accounts for it.
+ *
+ * Called under the rx lock of the queue pair.
+ *
+ * @param queue	Queue pair the buffer belongs to
+ * @param buf	Start of the area to invalidate
+ * @param len	Length of the area to invalidate
+ */
+static inline void rpmsg_virtio_buf_invalidate(struct rpmsg_virtio_queue *queue,
+					       void *buf, uint32_t len)
+{
+	BUFFER_INVALIDATE(buf, len);
+#if defined(VIRTIO_USE_DCACHE)
+	queue->rx_invalidated += len;
+#else
+	(void)queue;
+	(void)buf;
+	(void)len;
+#endif
 }
 
 /**
@@ -102,42 +394,102 @@ void rpmsg_virtio_init_shm_pool(struct rpmsg_virtio_shm_pool *shpool,
  * @brief Places the used buffer back on the virtqueue.
  *
  * @param rvdev		Pointer to remote core
+ * @param queue		Queue pair the buffer belongs to
  * @param buffer	Buffer pointer
  * @param len		Buffer length
  * @param idx		Buffer index
  */
 static void rpmsg_virtio_return_buffer(struct rpmsg_virtio_device *rvdev,
+				       struct rpmsg_virtio_queue *queue,
 				       void *buffer, uint32_t len,
 				       uint16_t idx)
 {
 	int ret;
 
-	BUFFER_INVALIDATE(buffer, len);
+	rpmsg_virtio_buf_invalidate(queue, buffer,
+				    rpmsg_virtio_msg_len(buffer, len));
 
-	if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev)) {
+	if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev) && queue->rvq->vq_fixed) {
+		/* The index is the descriptor bound to the buffer */
+		ret = virtqueue_add_fixed_buffer(queue->rvq, idx);
+		RPMSG_ASSERT(ret == VQUEUE_SUCCESS, "add buffer failed\r\n");
+	} else if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev)) {
 		struct virtqueue_buf vqbuf;
 
-		(void)idx;
 		/* Initialize buffer node */
 		vqbuf.buf = buffer;
 		vqbuf.len = len;
-		ret = virtqueue_add_buffer(rvdev->rvq, &vqbuf, 0, 1, buffer);
+		ret = virtqueue_add_buffer(queue->rvq, &vqbuf, 0, 1, buffer);
 		RPMSG_ASSERT(ret == VQUEUE_SUCCESS, "add buffer failed\r\n");
 	}
 
 	if (VIRTIO_ROLE_IS_DEVICE(rvdev->vdev)) {
 		(void)buffer;
-		ret = virtqueue_add_consumed_buffer(rvdev->rvq, idx, len);
+		ret = virtqueue_add_consumed_buffer(queue->rvq, idx, len);
 		RPMSG_ASSERT(ret == VQUEUE_SUCCESS, "add consumed buffer failed\r\n");
 	}
 }
 
+/**
+ * @internal
+ *
+ * @brief Places a batch of used rx buffers back on the virtqueue.
+ *
+ * The buffers are published to the other side with a single index update.
+ *
+ * @param rvdev		Pointer to remote core
+ * @param queue		Queue pair the buffers belong to
+ * @param rp_hdrs	Array of rx buffer headers
+ * @param num		Number of buffers, at most RPMSG_VIRTIO_BATCH_SIZE
+ */
+static void rpmsg_virtio_return_buffers(struct rpmsg_virtio_device *rvdev,
+					struct rpmsg_virtio_queue *queue,
+					struct rpmsg_hdr **rp_hdrs, int num)
+{
+	struct virtqueue_buf vqbuf[RPMSG_VIRTIO_BATCH_SIZE];
+	uint16_t idxs[RPMSG_VIRTIO_BATCH_SIZE];
+	uint32_t lens[RPMSG_VIRTIO_BATCH_SIZE];
+	void *cookies[RPMSG_VIRTIO_BATCH_SIZE];
+	struct rpmsg_hdr *rp_hdr;
+	int ret, i;
+
+	for (i = 0; i < num; i++) {
+		rp_hdr = rp_hdrs[i];
+		/* The reserved field contains buffer index */
+		idxs[i] = RPMSG_BUF_INDEX(rp_hdr);
+		lens[i] = virtqueue_get_buffer_length(queue->rvq, idxs[i]);
+		rpmsg_virtio_buf_invalidate(queue, rp_hdr,
+					    rpmsg_virtio_msg_len(rp_hdr, lens[i]));
+		vqbuf[i].buf = rp_hdr;
+		vqbuf[i].len = lens[i];
+		cookies[i] = rp_hdr;
+	}
+
+	if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev) && queue->rvq->vq_fixed) {
+		/* The indexes are the descriptors bound to the buffers */
+		ret = virtqueue_add_fixed_buffer_batch(queue->rvq, idxs, num);
+		RPMSG_ASSERT(ret == VQUEUE_SUCCESS, "add buffer failed\r\n");
+	} else if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev)) {
+		ret = virtqueue_add_buffer_batch(queue->rvq, vqbuf, num, 1,
+						 cookies);
+		RPMSG_ASSERT(ret == VQUEUE_SUCCESS, "add buffer failed\r\n");
+	}
+
+	if (VIRTIO_ROLE_IS_DEVICE(rvdev->vdev)) {
+		ret = virtqueue_add_consumed_buffer_batch(queue->rvq, idxs,
+							  lens, num);
+		RPMSG_ASSERT(ret == VQUEUE_SUCCESS,
+			     "add consumed buffer failed\r\n");
+	}
+}
+
 /**
  * @internal
  *
  * @brief Places buffer on the virtqueue for consumption by the other side.
  *
  * @param rvdev		Pointer to rpmsg virtio
+ * @param queue		Queue pair to send the buffer on
  * @param buffer	Buffer pointer
  * @param len		Buffer length
  * @param idx		Buffer index
@@ -145,10 +497,12 @@ static void rpmsg_virtio_return_buffer(struct rpmsg_virtio_device *rvdev,
  * @return Status of function execution
  */
 static int rpmsg_virtio_enqueue_buffer(struct rpmsg_virtio_device *rvdev,
+				       struct rpmsg_virtio_queue *queue,
 				       void *buffer, uint32_t len,
 				       uint16_t idx)
 {
-	BUFFER_FLUSH(buffer, len);
+	/* Only the header and the payload written have to reach the memory */
+	rpmsg_virtio_buf_flush(queue, buffer, rpmsg_virtio_msg_len(buffer, len));
 
 	if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev)) {
 		struct virtqueue_buf vqbuf;
@@ -157,57 +511,111 @@ static int rpmsg_virtio_enqueue_buffer(struct rpmsg_virtio_device *rvdev,
 		/* Initialize buffer node */
 		vqbuf.buf = buffer;
 		vqbuf.len = len;
-		return virtqueue_add_buffer(rvdev->svq, &vqbuf, 1, 0, buffer);
+		return virtqueue_add_buffer(queue->svq, &vqbuf, 1, 0, buffer);
 	}
 
 	if (VIRTIO_ROLE_IS_DEVICE(rvdev->vdev)) {
 		(void)buffer;
-		return virtqueue_add_consumed_buffer(rvdev->svq, idx, len);
+		return virtqueue_add_consumed_buffer(queue->svq, idx, len);
 	}
 
 	return 0;
 }
 
+/**
+ * @internal
+ *
+ * @brief Pushes a released tx buffer on the reclaimer of a queue pair.
+ *
+ * Lock-free, any number of threads may push concurrently.
+ *
+ * @param queue		Queue pair the buffer belongs to
+ * @param r_desc	Released buffer
+ */
+static void rpmsg_virtio_reclaimer_push(struct rpmsg_virtio_queue *queue,
+					struct vbuff_reclaimer_t *r_desc)
+{
+	uintptr_t head = atomic_load(&queue->reclaimer);
+
+	do {
+		r_desc->next = (struct vbuff_reclaimer_t *)head;
+	} while (!atomic_compare_exchange_weak(&queue->reclaimer, &head,
+					       (uintptr_t)r_desc));
+}
+
+/**
+ * @internal
+ *
+ * @brief Pops a released tx buffer from the reclaimer of a queue pair.
+ *
+ * Only one thread pops at a time, under tx_lock: a buffer cannot be popped
+ * and pushed again between the read of the head and its exchange.
+ *
+ * @param queue	Queue pair to pop the buffer from
+ *
+ * @return Released buffer, NULL if the reclaimer is empty
+ */
+static struct vbuff_reclaimer_t *
+rpmsg_virtio_reclaimer_pop(struct rpmsg_virtio_queue *queue)
+{
+	uintptr_t head = atomic_load(&queue->reclaimer);
+	struct vbuff_reclaimer_t *r_desc;
+
+	do {
+		r_desc = (struct vbuff_reclaimer_t *)head;
+		if (!r_desc)
+			return NULL;
+	} while (!atomic_compare_exchange_weak(&queue->reclaimer, &head,
+					       (uintptr_t)r_desc->next));
+
+	return r_desc;
+}
+
 /**
  * @internal
  *
  * @brief Provides buffer to transmit messages.
  *
  * @param rvdev	Pointer to rpmsg device
+ * @param queue	Queue pair to get the buffer from
  * @param len	Length of returned buffer
  * @param idx	Buffer index
  *
  * @return Pointer to buffer.
  */
 static void *rpmsg_virtio_get_tx_buffer(struct rpmsg_virtio_device *rvdev,
+					struct rpmsg_virtio_queue *queue,
 					uint32_t *len, uint16_t *idx)
 {
-	struct metal_list *node;
 	struct vbuff_reclaimer_t *r_desc;
 	void *data = NULL;
 
 	/* Try first to recycle a buffer that has been freed without been used */
-	node = metal_list_first(&rvdev->reclaimer);
-	if (node) {
-		r_desc = metal_container_of(node, struct vbuff_reclaimer_t, node);
-		metal_list_del(node);
+	r_desc = rpmsg_virtio_reclaimer_pop(queue);
+	if (r_desc) {
 		data = r_desc;
 		*idx = r_desc->idx;
 
 		if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev))
 			*len = rvdev->config.h2r_buf_size;
 		if (VIRTIO_ROLE_IS_DEVICE(rvdev->vdev))
-			*len = virtqueue_get_buffer_length(rvdev->svq, *idx);
+			*len = virtqueue_get_buffer_length(queue->svq, *idx);
 	} else if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev)) {
-		data = virtqueue_get_buffer(rvdev->svq, len, idx);
-		if (!data && rvdev->svq->vq_free_cnt) {
+		data = virtqueue_get_buffer(queue->svq, len, idx);
+		/*
+		 * Buffers held by senders have no descriptor, bound the buffers
+		 * of the queue pair rather than the free descriptors.
+		 */
+		if (!data && queue->tx_bufs < queue->svq->vq_nentries) {
 			data = rpmsg_virtio_shm_pool_get_buffer(rvdev->shpool,
 					rvdev->config.h2r_buf_size);
 			*len = rvdev->config.h2r_buf_size;
 			*idx = 0;
+			if (data)
+				queue->tx_bufs++;
 		}
 	} else if (VIRTIO_ROLE_IS_DEVICE(rvdev->vdev)) {
-		data = virtqueue_get_first_avail_buffer(rvdev->svq, idx, len);
+		data = virtqueue_get_first_avail_buffer(queue->svq, idx, len);
 	}
 
 	return data;
@@ -219,28 +627,40 @@ static void *rpmsg_virtio_get_tx_buffer(struct rpmsg_virtio_device *rvdev,
  * @brief Retrieves the received buffer from the virtqueue.
  *
  * @param rvdev	Pointer to rpmsg device
+ * @param queue	Queue pair to get the buffer from
  * @param len	Size of received buffer
  * @param idx	Index of buffer
  *
  * @return Pointer to received buffer
  */
 static void *rpmsg_virtio_get_rx_buffer(struct rpmsg_virtio_device *rvdev,
+					struct rpmsg_virtio_queue *queue,
 					uint32_t *len, uint16_t *idx)
 {
 	void *data = NULL;
 
 	if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev)) {
-		data = virtqueue_get_buffer(rvdev->rvq, len, idx);
+		data = virtqueue_get_buffer(queue->rvq, len, idx);
 	}
 
 	if (VIRTIO_ROLE_IS_DEVICE(rvdev->vdev)) {
 		data =
-		    virtqueue_get_first_avail_buffer(rvdev->rvq, idx, len);
+		    virtqueue_get_first_avail_buffer(queue->rvq, idx, len);
 	}
 
-	/* Invalidate the buffer before returning it */
-	if (data)
-		BUFFER_INVALIDATE(data, *len);
+	/*
+	 * Invalidate the header first, to read the payload length, then only
+	 * the payload before returning the buffer.
+	 */
+	if (data && *len > sizeof(struct rpmsg_hdr)) {
+		rpmsg_virtio_buf_invalidate(queue, data,
+					    sizeof(struct rpmsg_hdr));
+		rpmsg_virtio_buf_invalidate(queue, RPMSG_LOCATE_DATA(data),
+					    rpmsg_virtio_msg_len(data, *len) -
+					    sizeof(struct rpmsg_hdr));
+	} else if (data) {
+		rpmsg_virtio_buf_invalidate(queue, data, *len);
+	}
 
 	return data;
 }
@@ -305,22 +725,36 @@ static bool rpmsg_virtio_buf_held_dec_test(struct rpmsg_hdr *rp_hdr)
 
 static void rpmsg_virtio_hold_rx_buffer(struct rpmsg_device *rdev, void *rxbuf)
 {
-	metal_mutex_acquire(&rdev->lock);
-	RPMSG_BUF_HELD_INC(RPMSG_LOCATE_HDR(rxbuf));
-	metal_mutex_release(&rdev->lock);
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
+	struct rpmsg_hdr *rp_hdr;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+	rp_hdr = RPMSG_LOCATE_HDR(rxbuf);
+	queue = &rvdev->queues[RPMSG_BUF_QUEUE(rp_hdr)];
+
+	metal_mutex_acquire(&queue->rx_lock);
+	/* A wrapped counter would give the buffer back while still held */
+	if (RPMSG_BUF_HELD_COUNTER(rp_hdr) < RPMSG_BUF_HELD_MAX)
+		RPMSG_BUF_HELD_INC(rp_hdr);
+	else
+		metal_err("rx buffer held too many times\r\n");
+	metal_mutex_release(&queue->rx_lock);
 }
 
 static bool rpmsg_virtio_release_rx_buffer_nolock(struct rpmsg_virtio_device *rvdev,
 						  struct rpmsg_hdr *rp_hdr)
 {
+	struct rpmsg_virtio_queue *queue;
 	uint16_t idx;
 	uint32_t len;
 
-	/* The reserved field contains buffer index */
+	/* The reserved field contains buffer index and queue pair */
 	idx = RPMSG_BUF_INDEX(rp_hdr);
+	queue = &rvdev->queues[RPMSG_BUF_QUEUE(rp_hdr)];
 	/* Return buffer on virtqueue. */
-	len = virtqueue_get_buffer_length(rvdev->rvq, idx);
-	rpmsg_virtio_return_buffer(rvdev, rp_hdr, len, idx);
+	len = virtqueue_get_buffer_length(queue->rvq, idx);
+	rpmsg_virtio_return_buffer(rvdev, queue, rp_hdr, len, idx);
 
 	return true;
 }
@@ -329,18 +763,20 @@ static void rpmsg_virtio_release_rx_buffer(struct rpmsg_device *rdev,
 					   void *rxbuf)
 {
 	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
 	struct rpmsg_hdr *rp_hdr;
 
 	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
 	rp_hdr = RPMSG_LOCATE_HDR(rxbuf);
+	queue = &rvdev->queues[RPMSG_BUF_QUEUE(rp_hdr)];
 
-	metal_mutex_acquire(&rdev->lock);
+	metal_mutex_acquire(&queue->rx_lock);
 	if (rpmsg_virtio_buf_held_dec_test(rp_hdr)) {
 		rpmsg_virtio_release_rx_buffer_nolock(rvdev, rp_hdr);
 		/* Tell peer we returned an rx buffer */
-		virtqueue_kick(rvdev->rvq);
+		virtqueue_kick(queue->rvq);
 	}
-	metal_mutex_release(&rdev->lock);
+	metal_mutex_release(&queue->rx_lock);
 }
 
 static int rpmsg_virtio_notify_wait(struct rpmsg_virtio_device *rvdev, struct virtqueue *vq)
@@ -355,55 +791,93 @@ static int rpmsg_virtio_notify_wait(struct rpmsg_virtio_device *rvdev, struct vi
 	return rvdev->notify_wait_cb(&rvdev->rdev, vring_info->notifyid);
 }
 
-static void *rpmsg_virtio_get_tx_payload_buffer(struct rpmsg_device *rdev,
-						uint32_t *len, int wait)
+/**
+ * @internal
+ *
+ * @brief Returns the queue pair an endpoint sends on.
+ *
+ * Endpoints not bound with rpmsg_virtio_set_ept_queue() are spread over the
+ * queue pairs according to their address. The binding is set before the
+ * endpoint sends, so it is read without the device lock.
+ *
+ * @param rvdev	Pointer to rpmsg virtio device
+ * @param ept	Pointer to the endpoint
+ *
+ * @return Index of the queue pair
+ */
+static unsigned int rpmsg_virtio_ept_queue(struct rpmsg_virtio_device *rvdev,
+					   struct rpmsg_endpoint *ept)
 {
-	struct rpmsg_virtio_device *rvdev;
-	struct rpmsg_hdr *rp_hdr;
-	uint8_t virtio_status;
-	uint16_t idx;
-	int tick_count;
-	int status;
+	if (ept->queue < rvdev->num_queues)
+		return ept->queue;
 
-	/* Get the associated remote device for channel. */
-	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
-
-	/* Validate device state */
-	status = virtio_get_status(rvdev->vdev, &virtio_status);
-	if (status || !(virtio_status & VIRTIO_CONFIG_STATUS_DRIVER_OK))
-		return NULL;
+	return ept->addr % rvdev->num_queues;
+}
 
-	if (wait)
-		tick_count = RPMSG_TICK_COUNT / RPMSG_TICKS_PER_INTERVAL;
-	else
-		tick_count = 0;
+/**
+ * @internal
+ *
+ * @brief Unregisters a sender waiting for a tx buffer.
+ *
+ * The tx-done notifications are disabled again when no sender waits anymore.
+ *
+ * @param queue	Queue pair the sender waited on
+ */
+static void rpmsg_virtio_tx_wait_done(struct rpmsg_virtio_queue *queue)
+{
+	if (!--queue->tx_waiters)
+		virtqueue_disable_cb(queue->svq);
+}
 
-	while (1) {
-		/* Lock the device to enable exclusive access to virtqueues */
-		metal_mutex_acquire(&rdev->lock);
-		rp_hdr = rpmsg_virtio_get_tx_buffer(rvdev, len, &idx);
-		metal_mutex_release(&rdev->lock);
-		if (rp_hdr || !tick_count)
-			break;
+/**
+ * @internal
+ *
+ * @brief Starts the notification moderation timer, if not running yet.
+ *
+ * The timer is shared by the queue pairs, it is protected by the rpmsg device
+ * lock, taken after the queue locks.
+ *
+ * @param rvdev	Pointer to rpmsg virtio device
+ */
+static void rpmsg_virtio_start_notify_timer(struct rpmsg_virtio_device *rvdev)
+{
+	struct rpmsg_device *rdev = &rvdev->rdev;
 
-		/*
-		 * Try to use wait loop implemented in the virtio dispatcher and
-		 * use metal_sleep_usec() method by default.
-		 */
-		status = rpmsg_virtio_notify_wait(rvdev, rvdev->rvq);
-		if (status == RPMSG_EOPNOTSUPP) {
-			metal_sleep_usec(RPMSG_TICKS_PER_INTERVAL);
-			tick_count--;
-		} else if (status != RPMSG_SUCCESS) {
-			break;
-		}
+	metal_mutex_acquire(&rdev->lock);
+	/* The moderation may have been disabled since the caller checked */
+	if (rvdev->notify_max_bufs && !rvdev->notify_timer_armed) {
+		rvdev->notify_timer_armed = true;
+		rvdev->notify_timer_cb(rdev, rvdev->notify_timeout_us);
 	}
+	metal_mutex_release(&rdev->lock);
+}
+
+/**
+ * @internal
+ *
+ * @brief Reserves a tx buffer held by its sender.
+ *
+ * Called under the tx lock of the queue pair.
+ *
+ * @param rvdev	Pointer to rpmsg virtio device
+ * @param queue	Queue pair to get the buffer from
+ * @param len	Pointer to the payload buffer length
+ *
+ * @return Pointer to the payload buffer, NULL if none is available
+ */
+static void *rpmsg_virtio_reserve_tx_buffer(struct rpmsg_virtio_device *rvdev,
+					    struct rpmsg_virtio_queue *queue,
+					    uint32_t *len)
+{
+	struct rpmsg_hdr *rp_hdr;
+	uint16_t idx;
 
+	rp_hdr = rpmsg_virtio_get_tx_buffer(rvdev, queue, len, &idx);
 	if (!rp_hdr)
 		return NULL;
 
-	/* Store the index into the reserved field to be used when sending */
-	rp_hdr->reserved = idx;
+	/* Store the index and queue into the reserved field to be used when sending */
+	rp_hdr->reserved = RPMSG_BUF_RESERVED(idx, queue - rvdev->queues);
 
 	/* Increase the held counter to hold this Tx buffer */
 	RPMSG_BUF_HELD_INC(rp_hdr);
@@ -413,88 +887,708 @@ static void *rpmsg_virtio_get_tx_payload_buffer(struct rpmsg_device *rdev,
 	return RPMSG_LOCATE_DATA(rp_hdr);
 }
 
-static int rpmsg_virtio_send_offchannel_nocopy(struct rpmsg_device *rdev,
-					       uint32_t src, uint32_t dst,
-					       const void *data, int len)
-{
-	struct rpmsg_virtio_device *rvdev;
-	struct metal_io_region *io;
-	struct rpmsg_hdr rp_hdr;
-	struct rpmsg_hdr *hdr;
-	uint32_t buff_len;
-	uint16_t idx;
+/**
+ * @internal
+ *
+ * @brief Provides tx payload buffers of the given queue pair.
+ *
+ * The device state is checked and the queue pair locked once for the whole
+ * batch. When waiting, only the first buffer is waited for, the others are
+ * the buffers available at that time.
+ *
+ * @param rdev		Pointer to rpmsg device
+ * @param qid		Index of the queue pair
+ * @param buffers	Array to store the payload buffers
+ * @param num		Number of buffers requested
+ * @param len		Pointer to the length of the smallest payload buffer
+ * @param wait		Boolean, wait or not for buffer to become available
+ *
+ * @return Number of payload buffers provided
+ */
+static int rpmsg_virtio_get_tx_queue_buffers(struct rpmsg_device *rdev,
+					     unsigned int qid, void **buffers,
+					     int num, uint32_t *len, int wait)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
+	uint8_t virtio_status;
+	uint32_t timeout_us;
+	uint32_t buf_len;
+	int tick_count;
 	int status;
+	int count;
 
 	/* Get the associated remote device for channel. */
 	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+	queue = &rvdev->queues[qid];
 
-	hdr = RPMSG_LOCATE_HDR(data);
-	/* The reserved field contains buffer index */
-	idx = hdr->reserved;
+	/* Validate device state */
+	status = virtio_get_status(rvdev->vdev, &virtio_status);
+	if (status || !(virtio_status & VIRTIO_CONFIG_STATUS_DRIVER_OK))
+		return 0;
+
+	/* The timeout applies to the whole wait, not to each wake-up */
+	timeout_us = wait ? rvdev->tx_timeout_us : 0;
+	tick_count = timeout_us / RPMSG_TICKS_PER_INTERVAL;
+
+	while (1) {
+		/* Lock the queue pair to enable exclusive access to its tx side */
+		metal_mutex_acquire(&queue->tx_lock);
+		buffers[0] = rpmsg_virtio_reserve_tx_buffer(rvdev, queue, len);
+		/* The remote cannot free buffers of messages it is not aware of */
+		if (!buffers[0] && queue->svq->vq_queued_cnt)
+			virtqueue_kick(queue->svq);
+		if (!buffers[0] && timeout_us && rvdev->tx_wait_cb) {
+			/* Get notified when the remote releases a buffer */
+			if (!queue->tx_waiters++) {
+				virtqueue_enable_cb(queue->svq);
+				/* Moderated tx-done notifications may never come */
+				if (queue->tx_max_bufs)
+					rpmsg_virtio_start_notify_timer(rvdev);
+			}
+			/* A buffer may have been released before that */
+			buffers[0] = rpmsg_virtio_reserve_tx_buffer(rvdev, queue,
+								    len);
+			if (buffers[0])
+				rpmsg_virtio_tx_wait_done(queue);
+		}
+		for (count = buffers[0] ? 1 : 0; count && count < num; count++) {
+			buffers[count] = rpmsg_virtio_reserve_tx_buffer(rvdev,
+									queue,
+									&buf_len);
+			if (!buffers[count])
+				break;
+			*len = metal_min(*len, buf_len);
+		}
+		metal_mutex_release(&queue->tx_lock);
+		if (count || !wait)
+			break;
+
+		if (rvdev->tx_wait_cb) {
+			/* Registered as waiter above only while time is left */
+			if (!timeout_us)
+				break;
+			status = rvdev->tx_wait_cb(rdev, &timeout_us);
+			metal_mutex_acquire(&queue->tx_lock);
+			rpmsg_virtio_tx_wait_done(queue);
+			metal_mutex_release(&queue->tx_lock);
+			if (status != RPMSG_SUCCESS)
+				break;
+			continue;
+		}
+		if (!tick_count)
+			break;
+
+		/*
+		 * Try to use wait loop implemented in the virtio dispatcher and
+		 * use metal_sleep_usec() method by default.
+		 */
+		status = rpmsg_virtio_notify_wait(rvdev, queue->rvq);
+		if (status == RPMSG_EOPNOTSUPP) {
+			metal_sleep_usec(RPMSG_TICKS_PER_INTERVAL);
+			tick_count--;
+		} else if (status != RPMSG_SUCCESS) {
+			break;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * @internal
+ *
+ * @brief Provides a tx payload buffer of the given queue pair.
+ *
+ * @param rdev	Pointer to rpmsg device
+ * @param qid	Index of the queue pair
+ * @param len	Pointer to the payload buffer length
+ * @param wait	Boolean, wait or not for buffer to become available
+ *
+ * @return Pointer to the payload buffer, NULL on failure
+ */
+static void *rpmsg_virtio_get_tx_queue_buffer(struct rpmsg_device *rdev,
+					      unsigned int qid, uint32_t *len,
+					      int wait)
+{
+	void *buffer;
+
+	if (!rpmsg_virtio_get_tx_queue_buffers(rdev, qid, &buffer, 1, len,
+					       wait))
+		return NULL;
+
+	return buffer;
+}
+
+static void *rpmsg_virtio_get_tx_payload_buffer(struct rpmsg_device *rdev,
+						uint32_t *len, int wait)
+{
+	/* Zero-copy buffers are not tied to an endpoint, use the first queue */
+	return rpmsg_virtio_get_tx_queue_buffer(rdev, 0, len, wait);
+}
+
+static int rpmsg_virtio_get_tx_payload_buffers(struct rpmsg_device *rdev,
+					       void **buffers, int num,
+					       uint32_t *len, int wait)
+{
+	/* Like rpmsg_virtio_get_tx_payload_buffer(), use the first queue */
+	return rpmsg_virtio_get_tx_queue_buffers(rdev, 0, buffers, num, len,
+						 wait);
+}
+
+/**
+ * @internal
+ *
+ * @brief Allocates the descriptors of the messages queued on their endpoint.
+ *
+ * They are only needed by the deferred rx dispatch and the endpoints read
+ * with rpmsg_recv_nocopy(), so they are allocated the first time one of
+ * them is used, and kept until the device is deinitialized. Called under the
+ * rpmsg device lock.
+ *
+ * @param rvdev	Pointer to rpmsg virtio device
+ *
+ * @return RPMSG_SUCCESS on success, RPMSG_ERR_NO_MEM on failure
+ */
+static int rpmsg_virtio_alloc_rx_msgs(struct rpmsg_virtio_device *rvdev)
+{
+	struct rpmsg_virtio_queue *queue;
+	unsigned int i;
+
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		if (queue->rx_msgs)
+			continue;
+		queue->rx_msgs = metal_allocate_memory(queue->rvq->vq_nentries *
+						       sizeof(*queue->rx_msgs));
+		if (!queue->rx_msgs)
+			return RPMSG_ERR_NO_MEM;
+	}
+
+	return RPMSG_SUCCESS;
+}
+
+static int rpmsg_virtio_enable_recv_nocopy(struct rpmsg_device *rdev)
+{
+	struct rpmsg_virtio_device *rvdev;
+	int status;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+
+	metal_mutex_acquire(&rdev->lock);
+	status = rpmsg_virtio_alloc_rx_msgs(rvdev);
+	metal_mutex_release(&rdev->lock);
+
+	return status;
+}
+
+static int rpmsg_virtio_recv_nocopy(struct rpmsg_device *rdev,
+				    struct rpmsg_endpoint *ept, void **data,
+				    uint32_t *src, uint32_t timeout_us)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_hdr *rp_hdr = NULL;
+	struct rpmsg_rx_msg *msg;
+	struct metal_list *node;
+	unsigned int qid;
+	int tick_count;
+	int status;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+	/* The remote usually answers on the queue pair the endpoint sends on */
+	qid = rpmsg_virtio_ept_queue(rvdev, ept);
+	/* Round up, so that a short timeout still waits for one interval */
+	tick_count = (timeout_us + RPMSG_TICKS_PER_INTERVAL - 1) / RPMSG_TICKS_PER_INTERVAL;
+
+	while (1) {
+		metal_mutex_acquire(&rdev->lock);
+		node = metal_list_first(&ept->rx_msgs);
+		if (node) {
+			metal_list_del(node);
+			msg = metal_container_of(node, struct rpmsg_rx_msg,
+						 node);
+			rp_hdr = msg->hdr;
+			/* The buffer stays held, the message reference not */
+			rpmsg_ept_decref(ept);
+		}
+		metal_mutex_release(&rdev->lock);
+		if (rp_hdr || !tick_count)
+			break;
+
+		/*
+		 * Try to use wait loop implemented in the virtio dispatcher and
+		 * use metal_sleep_usec() method by default. Each wait of the
+		 * dispatcher counts as one interval, so that the timeout also
+		 * elapses while notifications keep coming for other endpoints.
+		 * The remote may send on any queue pair, so the waits go round
+		 * all of them.
+		 */
+		status = rpmsg_virtio_notify_wait(rvdev, rvdev->queues[qid].rvq);
+		if (status == RPMSG_EOPNOTSUPP)
+			metal_sleep_usec(RPMSG_TICKS_PER_INTERVAL);
+		else if (status != RPMSG_SUCCESS)
+			return status;
+		qid = (qid + 1) % rvdev->num_queues;
+		tick_count--;
+	}
+
+	if (!rp_hdr)
+		return RPMSG_ERR_NO_BUFF;
+
+	metal_mutex_acquire(&rdev->lock);
+	if (ept->dest_addr == RPMSG_ADDR_ANY)
+		ept->dest_addr = rp_hdr->src;
+	metal_mutex_release(&rdev->lock);
+	if (src)
+		*src = rp_hdr->src;
+	*data = RPMSG_LOCATE_DATA(rp_hdr);
+
+	return rp_hdr->len;
+}
+
+/**
+ * @internal
+ *
+ * @brief Writes the rpmsg header of a tx buffer.
+ *
+ * @param rvdev	Pointer to rpmsg virtio device
+ * @param hdr	Header of the tx buffer
+ * @param src	Source address of channel
+ * @param dst	Destination address of channel
+ * @param len	Size of the payload
+ * @param flags	Flags of the rpmsg header
+ */
+static void rpmsg_virtio_write_hdr(struct rpmsg_virtio_device *rvdev,
+				   struct rpmsg_hdr *hdr, uint32_t src,
+				   uint32_t dst, int len, uint16_t flags)
+{
+	struct metal_io_region *io = rvdev->shbuf_io;
+	struct rpmsg_hdr rp_hdr;
+	int status;
 
 	/* Initialize RPMSG header. */
 	rp_hdr.dst = dst;
 	rp_hdr.src = src;
 	rp_hdr.len = len;
 	rp_hdr.reserved = 0;
-	rp_hdr.flags = 0;
+	rp_hdr.flags = flags;
 
 	/* Copy data to rpmsg buffer. */
-	io = rvdev->shbuf_io;
 	status = metal_io_block_write(io, metal_io_virt_to_offset(io, hdr),
 				      &rp_hdr, sizeof(rp_hdr));
 	RPMSG_ASSERT(status == sizeof(rp_hdr), "failed to write header\r\n");
+}
 
-	metal_mutex_acquire(&rdev->lock);
+/**
+ * @internal
+ *
+ * @brief Sends a tx buffer with the given header flags.
+ *
+ * @param rdev	Pointer to rpmsg device
+ * @param src	Source address of channel
+ * @param dst	Destination address of channel
+ * @param data	Payload of the tx buffer
+ * @param len	Size of data
+ * @param flags	Flags of the rpmsg header
+ *
+ * @return Size of data sent or negative value for failure.
+ */
+static int rpmsg_virtio_send_buffer(struct rpmsg_device *rdev, uint32_t src,
+				    uint32_t dst, const void *data, int len,
+				    uint16_t flags)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
+	struct rpmsg_hdr *hdr;
+	uint32_t buff_len;
+	uint16_t idx;
+	int status;
+
+	/* Get the associated remote device for channel. */
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+
+	hdr = RPMSG_LOCATE_HDR(data);
+	/* The reserved field contains buffer index and queue pair */
+	idx = RPMSG_BUF_INDEX(hdr);
+	queue = &rvdev->queues[RPMSG_BUF_QUEUE(hdr)];
+
+	rpmsg_virtio_write_hdr(rvdev, hdr, src, dst, len, flags);
+
+	metal_mutex_acquire(&queue->tx_lock);
 
 	if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev))
 		buff_len = rvdev->config.h2r_buf_size;
 	else
-		buff_len = virtqueue_get_buffer_length(rvdev->svq, idx);
+		buff_len = virtqueue_get_buffer_length(queue->svq, idx);
 
 	/* Enqueue buffer on virtqueue. */
-	status = rpmsg_virtio_enqueue_buffer(rvdev, hdr, buff_len, idx);
+	status = rpmsg_virtio_enqueue_buffer(rvdev, queue, hdr, buff_len, idx);
 	RPMSG_ASSERT(status == VQUEUE_SUCCESS, "failed to enqueue buffer\r\n");
 	/* Let the other side know that there is a job to process. */
-	virtqueue_kick(rvdev->svq);
+	if (queue->svq->vq_queued_cnt >= rvdev->tx_kick_batch)
+		virtqueue_kick(queue->svq);
 
-	metal_mutex_release(&rdev->lock);
+	metal_mutex_release(&queue->tx_lock);
 
 	return len;
 }
 
+static int rpmsg_virtio_send_offchannel_nocopy(struct rpmsg_device *rdev,
+					       uint32_t src, uint32_t dst,
+					       const void *data, int len)
+{
+	return rpmsg_virtio_send_buffer(rdev, src, dst, data, len, 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Sends tx buffers of a queue pair with a single index update.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device
+ * @param queue		Queue pair the buffers belong to
+ * @param src		Source address of channel
+ * @param dst		Destination address of channel
+ * @param msgs		Payloads of the tx buffers and their sizes
+ * @param num		Number of buffers, at most RPMSG_VIRTIO_BATCH_SIZE
+ * @param kick		Whether to notify the remote once enqueued
+ */
+static void rpmsg_virtio_send_buffers(struct rpmsg_virtio_device *rvdev,
+				      struct rpmsg_virtio_queue *queue,
+				      uint32_t src, uint32_t dst,
+				      const struct rpmsg_iovec *msgs, int num,
+				      bool kick)
+{
+	struct virtqueue_buf vqbuf[RPMSG_VIRTIO_BATCH_SIZE];
+	uint16_t idxs[RPMSG_VIRTIO_BATCH_SIZE];
+	uint32_t lens[RPMSG_VIRTIO_BATCH_SIZE];
+	void *cookies[RPMSG_VIRTIO_BATCH_SIZE];
+	struct rpmsg_hdr *hdr;
+	int status, i;
+
+	for (i = 0; i < num; i++) {
+		hdr = RPMSG_LOCATE_HDR(msgs[i].base);
+		idxs[i] = RPMSG_BUF_INDEX(hdr);
+		rpmsg_virtio_write_hdr(rvdev, hdr, src, dst, msgs[i].len, 0);
+	}
+
+	metal_mutex_acquire(&queue->tx_lock);
+	for (i = 0; i < num; i++) {
+		hdr = RPMSG_LOCATE_HDR(msgs[i].base);
+		if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev))
+			lens[i] = rvdev->config.h2r_buf_size;
+		else
+			lens[i] = virtqueue_get_buffer_length(queue->svq,
+							      idxs[i]);
+		/* Only the header and the payload written have to reach the memory */
+		rpmsg_virtio_buf_flush(queue, hdr,
+				       rpmsg_virtio_msg_len(hdr, lens[i]));
+		vqbuf[i].buf = hdr;
+		vqbuf[i].len = lens[i];
+		cookies[i] = hdr;
+	}
+
+	/* Enqueue the buffers on the virtqueue */
+	if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev))
+		status = virtqueue_add_buffer_batch(queue->svq, vqbuf, num, 0,
+						    cookies);
+	else
+		status = virtqueue_add_consumed_buffer_batch(queue->svq, idxs,
+							     lens, num);
+	RPMSG_ASSERT(status == VQUEUE_SUCCESS, "failed to enqueue buffer\r\n");
+	/* Let the other side know that there is a job to process. */
+	if (kick && queue->svq->vq_queued_cnt >= rvdev->tx_kick_batch)
+		virtqueue_kick(queue->svq);
+
+	metal_mutex_release(&queue->tx_lock);
+}
+
+static int rpmsg_virtio_send_offchannel_nocopy_batch(struct rpmsg_device *rdev,
+						     uint32_t src, uint32_t dst,
+						     const struct rpmsg_iovec *msgs,
+						     int num)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_hdr *hdr;
+	unsigned int qid;
+	int sent, count;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+
+	/* Consecutive buffers of the same queue pair are sent together */
+	for (sent = 0; sent < num; sent += count) {
+		hdr = RPMSG_LOCATE_HDR(msgs[sent].base);
+		qid = RPMSG_BUF_QUEUE(hdr);
+		for (count = 1; count < RPMSG_VIRTIO_BATCH_SIZE &&
+		     sent + count < num; count++) {
+			hdr = RPMSG_LOCATE_HDR(msgs[sent + count].base);
+			if (RPMSG_BUF_QUEUE(hdr) != qid)
+				break;
+		}
+		rpmsg_virtio_send_buffers(rvdev, &rvdev->queues[qid], src, dst,
+					  &msgs[sent], count, true);
+	}
+
+	return sent;
+}
+
 static int rpmsg_virtio_release_tx_buffer(struct rpmsg_device *rdev, void *txbuf)
 {
 	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
 	struct rpmsg_hdr *rp_hdr = RPMSG_LOCATE_HDR(txbuf);
 	void *vbuff = rp_hdr;  /* only used to avoid warning on the cast of a packed structure */
 	struct vbuff_reclaimer_t *r_desc = (struct vbuff_reclaimer_t *)vbuff;
 
 	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+	queue = &rvdev->queues[RPMSG_BUF_QUEUE(rp_hdr)];
 
-	metal_mutex_acquire(&rdev->lock);
-
-	/* Check whether to release the Tx buffer */
+	/*
+	 * A tx buffer is owned by its sender until released, only the push on
+	 * the reclaimer is shared with the other senders.
+	 */
 	if (rpmsg_virtio_buf_held_dec_test(rp_hdr)) {
 		/*
 		 * Reuse the RPMsg buffer to temporary store the vbuff_reclaimer_t structure.
 		 * Store the index locally before overwriting the RPMsg header.
 		 */
 		r_desc->idx = RPMSG_BUF_INDEX(rp_hdr);
-		metal_list_add_tail(&rvdev->reclaimer, &r_desc->node);
+		rpmsg_virtio_reclaimer_push(queue, r_desc);
 	}
 
-	metal_mutex_release(&rdev->lock);
-
 	return RPMSG_SUCCESS;
 }
 
+static int rpmsg_virtio_send_offchannel_batch(struct rpmsg_device *rdev,
+					      struct rpmsg_endpoint *ept,
+					      uint32_t src, uint32_t dst,
+					      const struct rpmsg_iovec *msgs,
+					      int num, int wait)
+{
+	struct rpmsg_iovec bufs[RPMSG_VIRTIO_BATCH_SIZE];
+	void *buffers[RPMSG_VIRTIO_BATCH_SIZE];
+	struct rpmsg_virtio_device *rvdev;
+	struct metal_io_region *io;
+	size_t max_len = SIZE_MAX;
+	bool too_long = false;
+	uint32_t buff_len;
+	int sent, count, n, i;
+	unsigned int qid;
+	int status;
+
+	/* Get the associated remote device for channel. */
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+
+	/* The host knows the size of its tx buffers before reserving them */
+	if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev))
+		max_len = rvdev->config.h2r_buf_size - sizeof(struct rpmsg_hdr);
+
+	for (i = 0; i < num; i++) {
+		if (!msgs[i].base && msgs[i].len)
+			return RPMSG_ERR_PARAM;
+		/* Unlike rpmsg_send(), a message is never truncated */
+		if (msgs[i].len > max_len)
+			return RPMSG_ERR_PARAM;
+	}
+
+	qid = rpmsg_virtio_ept_queue(rvdev, ept);
+	io = rvdev->shbuf_io;
+
+	for (sent = 0; sent < num; sent += count) {
+		/* Reserve the buffers of a batch under a single lock */
+		n = metal_min(num - sent, RPMSG_VIRTIO_BATCH_SIZE);
+		count = rpmsg_virtio_get_tx_queue_buffers(rdev, qid, buffers, n,
+							  &buff_len, wait);
+		if (!count)
+			break;
+
+		/* The buffers provided by the remote may still be too small */
+		for (i = 0; i < count; i++) {
+			if (msgs[sent + i].len > buff_len)
+				break;
+		}
+		too_long = i < count;
+		for (n = i; n < count; n++)
+			rpmsg_virtio_release_tx_buffer(rdev, buffers[n]);
+		count = i;
+		if (!count)
+			break;
+
+		for (i = 0; i < count; i++) {
+			bufs[i].base = buffers[i];
+			bufs[i].len = msgs[sent + i].len;
+			status = metal_io_block_write(io,
+						      metal_io_virt_to_offset(io, buffers[i]),
+						      msgs[sent + i].base,
+						      bufs[i].len);
+			RPMSG_ASSERT(status == (int)bufs[i].len,
+				     "failed to write buffer\r\n");
+		}
+
+		/*
+		 * Notify the remote once for the whole batch. When the buffers
+		 * run out, the queued messages are notified while waiting.
+		 */
+		rpmsg_virtio_send_buffers(rvdev, &rvdev->queues[qid], src, dst,
+					  bufs, count,
+					  too_long || sent + count == num);
+		if (too_long) {
+			sent += count;
+			break;
+		}
+	}
+
+	if (sent)
+		return sent;
+
+	return too_long ? RPMSG_ERR_PARAM : RPMSG_ERR_NO_BUFF;
+}
+
+/**
+ * @internal
+ *
+ * @brief Gathers chunks of a message in a tx buffer.
+ *
+ * @param io		Shared buffer I/O region
+ * @param buffer	Payload of the tx buffer
+ * @param iov		Current chunk, updated to the chunk to continue from
+ * @param offset	Offset in the current chunk, updated as well
+ * @param len		Number of bytes to copy
+ */
+static void rpmsg_virtio_write_iov(struct metal_io_region *io, void *buffer,
+				   const struct rpmsg_iovec **iov,
+				   size_t *offset, int len)
+{
+	unsigned long buf_offset = metal_io_virt_to_offset(io, buffer);
+	int chunk, status;
+
+	while (len > 0) {
+		chunk = metal_min((size_t)len, (*iov)->len - *offset);
+		if (chunk) {
+			status = metal_io_block_write(io, buf_offset,
+						      (const char *)(*iov)->base +
+						      *offset, chunk);
+			RPMSG_ASSERT(status == chunk,
+				     "failed to write buffer\r\n");
+			buf_offset += chunk;
+			len -= chunk;
+			*offset += chunk;
+		}
+		if (*offset == (*iov)->len) {
+			(*iov)++;
+			*offset = 0;
+		}
+	}
+}
+
+/**
+ * @internal
+ *
+ * @brief This function sends rpmsg "message" gathered from several chunks
+ * to remote device.
+ *
+ * @param rdev		Pointer to rpmsg device
+ * @param ept		Pointer to the sending endpoint
+ * @param src		Source address of channel
+ * @param dst		Destination address of channel
+ * @param iov		Chunks of data to transmit
+ * @param iovcnt	Number of chunks
+ * @param wait		Boolean, wait or not for buffer to become
+ *			available
+ *
+ * @return Size of data sent or negative value for failure.
+ */
+static int rpmsg_virtio_sendv_offchannel_raw(struct rpmsg_device *rdev,
+					     struct rpmsg_endpoint *ept,
+					     uint32_t src, uint32_t dst,
+					     const struct rpmsg_iovec *iov,
+					     int iovcnt, int wait)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct metal_io_region *io;
+	int offset = 0, chunk, len = 0;
+	size_t iov_offset = 0;
+	uint32_t buff_len;
+	unsigned int qid;
+	uint16_t flags;
+	void *buffer;
+	int i, status;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].base && iov[i].len)
+			return RPMSG_ERR_PARAM;
+		if (iov[i].len > (size_t)(INT32_MAX - len))
+			return RPMSG_ERR_PARAM;
+		len += iov[i].len;
+	}
+
+	/* Get the associated remote device for channel. */
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+
+	/* Get the payload buffer from the queue pair of the endpoint. */
+	qid = rpmsg_virtio_ept_queue(rvdev, ept);
+	buffer = rpmsg_virtio_get_tx_queue_buffer(rdev, qid, &buff_len, wait);
+	if (!buffer)
+		return RPMSG_ERR_NO_BUFF;
+
+	io = rvdev->shbuf_io;
+	if (len <= (int)buff_len || !ept->frag) {
+		/* Gather data in rpmsg buffer. */
+		if (len > (int)buff_len)
+			len = buff_len;
+		rpmsg_virtio_write_iov(io, buffer, &iov, &iov_offset, len);
+
+		return rpmsg_virtio_send_offchannel_nocopy(rdev, src, dst,
+							   buffer, len);
+	}
+
+	/*
+	 * Split the message over as many buffers as needed, the fragments of
+	 * the messages sent by other threads on the endpoint are not
+	 * interleaved.
+	 */
+	metal_mutex_acquire(&ept->frag_tx_lock);
+	flags = RPMSG_HDR_F_FRAG | RPMSG_HDR_F_FRAG_FIRST;
+	while (1) {
+		chunk = metal_min(len - offset, (int)buff_len);
+		if (offset + chunk == len)
+			flags |= RPMSG_HDR_F_FRAG_LAST;
+		rpmsg_virtio_write_iov(io, buffer, &iov, &iov_offset, chunk);
+
+		status = rpmsg_virtio_send_buffer(rdev, src, dst, buffer,
+						  chunk, flags);
+		if (status < 0)
+			break;
+		offset += chunk;
+		if (offset == len) {
+			status = len;
+			break;
+		}
+
+		flags = RPMSG_HDR_F_FRAG;
+		buffer = rpmsg_virtio_get_tx_queue_buffer(rdev, qid, &buff_len,
+							  wait);
+		if (!buffer) {
+			/*
+			 * The fragments already sent cannot be taken back, the
+			 * remote drops them at the next first fragment.
+			 */
+			status = RPMSG_ERR_NO_BUFF;
+			break;
+		}
+	}
+	metal_mutex_release(&ept->frag_tx_lock);
+
+	return status;
+}
+
 /**
  * @internal
  *
  * @brief This function sends rpmsg "message" to remote device.
  *
  * @param rdev	Pointer to rpmsg device
+ * @param ept	Pointer to the sending endpoint
  * @param src	Source address of channel
  * @param dst	Destination address of channel
  * @param data	Data to transmit
@@ -505,46 +1599,554 @@ static int rpmsg_virtio_release_tx_buffer(struct rpmsg_device *rdev, void *txbuf
  * @return Size of data sent or negative value for failure.
  */
 static int rpmsg_virtio_send_offchannel_raw(struct rpmsg_device *rdev,
+					    struct rpmsg_endpoint *ept,
 					    uint32_t src, uint32_t dst,
 					    const void *data,
 					    int len, int wait)
+{
+	struct rpmsg_iovec iov = {
+		.base = data,
+		.len = len,
+	};
+
+	return rpmsg_virtio_sendv_offchannel_raw(rdev, ept, src, dst, &iov, 1,
+						 wait);
+}
+
+/**
+ * @internal
+ *
+ * @brief Notifies the remote of the tx messages queued and not notified.
+ *
+ * @param rdev	Pointer to rpmsg device
+ *
+ * @return RPMSG_SUCCESS
+ */
+static int rpmsg_virtio_flush(struct rpmsg_device *rdev)
 {
 	struct rpmsg_virtio_device *rvdev;
-	struct metal_io_region *io;
-	uint32_t buff_len;
-	void *buffer;
+	struct rpmsg_virtio_queue *queue;
+	unsigned int i;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		metal_mutex_acquire(&queue->tx_lock);
+		if (queue->svq->vq_queued_cnt)
+			virtqueue_kick(queue->svq);
+		metal_mutex_release(&queue->tx_lock);
+	}
+
+	return RPMSG_SUCCESS;
+}
+
+/**
+ * @internal
+ *
+ * @brief Tx callback function.
+ *
+ * @param vq	Pointer to virtqueue on which Tx is has been
+ *		completed.
+ */
+static void rpmsg_virtio_tx_callback(struct virtqueue *vq)
+{
+	struct rpmsg_virtio_device *rvdev = vq->vq_dev->priv;
+
+	/* Only enabled while senders wait for the buffers being released */
+	if (rvdev->tx_wake_cb)
+		rvdev->tx_wake_cb(&rvdev->rdev);
+}
+
+/**
+ * @internal
+ *
+ * @brief Adds a received fragment to the message reassembled by an endpoint.
+ *
+ * The endpoint callback is called once the last fragment is received. A
+ * message that does not fit in the reassembly buffer is dropped. While a
+ * message is reassembled, the fragments of other sources are dropped, until
+ * its last fragment. The reassembly state is protected by the endpoint
+ * frag_rx_lock, held across the callback, as the fragments may be received
+ * concurrently on several queue pairs.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device
+ * @param ept		Pointer to the destination endpoint
+ * @param rp_hdr	Header of the received fragment
+ */
+static void rpmsg_virtio_rx_fragment(struct rpmsg_virtio_device *rvdev,
+				     struct rpmsg_endpoint *ept,
+				     struct rpmsg_hdr *rp_hdr)
+{
+	struct metal_io_region *io = rvdev->shbuf_io;
+	unsigned char *data = RPMSG_LOCATE_DATA(rp_hdr);
+	int status;
+
+	metal_mutex_acquire(&ept->frag_rx_lock);
+
+	/* Reassembly buffer removed since the fragment was routed */
+	if (!ept->frag_buf)
+		goto out;
+
+	/*
+	 * Fragments of another remote endpoint, including the first one of a
+	 * new message, would corrupt the message being reassembled.
+	 */
+	if (ept->frag_valid && rp_hdr->src != ept->frag_src)
+		goto out;
+
+	if (rp_hdr->flags & RPMSG_HDR_F_FRAG_FIRST) {
+		ept->frag_valid = true;
+		ept->frag_len = 0;
+		ept->frag_src = rp_hdr->src;
+	}
+
+	/* Fragment of a message already dropped */
+	if (!ept->frag_valid)
+		goto out;
+
+	if (rp_hdr->len > ept->frag_size - ept->frag_len) {
+		ept->frag_valid = false;
+		goto out;
+	}
+
+	metal_io_block_read(io, metal_io_virt_to_offset(io, data),
+			    (unsigned char *)ept->frag_buf + ept->frag_len,
+			    rp_hdr->len);
+	ept->frag_len += rp_hdr->len;
+
+	if (rp_hdr->flags & RPMSG_HDR_F_FRAG_LAST) {
+		ept->frag_valid = false;
+		status = ept->cb(ept, ept->frag_buf, ept->frag_len,
+				 rp_hdr->src, ept->priv);
+
+		RPMSG_ASSERT(status >= 0, "unexpected callback status\r\n");
+	}
+
+out:
+	metal_mutex_release(&ept->frag_rx_lock);
+}
+
+/**
+ * @internal
+ *
+ * @brief Delivers a received message to its endpoint.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device
+ * @param ept		Pointer to the destination endpoint
+ * @param rp_hdr	Header of the received message
+ */
+static void rpmsg_virtio_rx_deliver(struct rpmsg_virtio_device *rvdev,
+				    struct rpmsg_endpoint *ept,
+				    struct rpmsg_hdr *rp_hdr)
+{
 	int status;
 
-	/* Get the associated remote device for channel. */
-	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+	if (ept->dest_addr == RPMSG_ADDR_ANY) {
+		/*
+		 * First message received from the remote side,
+		 * update channel destination address
+		 */
+		ept->dest_addr = rp_hdr->src;
+	}
+	if ((rp_hdr->flags & RPMSG_HDR_F_FRAG) && ept->frag_buf) {
+		rpmsg_virtio_rx_fragment(rvdev, ept, rp_hdr);
+	} else {
+		status = ept->cb(ept, RPMSG_LOCATE_DATA(rp_hdr), rp_hdr->len,
+				 rp_hdr->src, ept->priv);
+
+		RPMSG_ASSERT(status >= 0, "unexpected callback status\r\n");
+	}
+}
+
+/**
+ * @internal
+ *
+ * @brief Tells whether a received message can be given to a batch callback.
+ *
+ * Fragments reassembled by the endpoint are delivered one by one.
+ *
+ * @param ept		Pointer to the destination endpoint
+ * @param rp_hdr	Header of the received message
+ *
+ * @return true if the message can be delivered in a batch
+ */
+static bool rpmsg_virtio_rx_batchable(struct rpmsg_endpoint *ept,
+				      struct rpmsg_hdr *rp_hdr)
+{
+	return ept->batch_cb &&
+	       !((rp_hdr->flags & RPMSG_HDR_F_FRAG) && ept->frag_buf);
+}
+
+/**
+ * @internal
+ *
+ * @brief Delivers consecutive received messages to a batch callback.
+ *
+ * @param ept		Pointer to the destination endpoint
+ * @param rp_hdrs	Headers of the received messages
+ * @param num		Number of messages, at most RPMSG_VIRTIO_BATCH_SIZE
+ */
+static void rpmsg_virtio_rx_deliver_batch(struct rpmsg_endpoint *ept,
+					  struct rpmsg_hdr **rp_hdrs, int num)
+{
+	struct rpmsg_rx_desc msgs[RPMSG_VIRTIO_BATCH_SIZE];
+	int status, i;
+
+	if (ept->dest_addr == RPMSG_ADDR_ANY)
+		ept->dest_addr = rp_hdrs[0]->src;
+
+	for (i = 0; i < num; i++) {
+		msgs[i].data = RPMSG_LOCATE_DATA(rp_hdrs[i]);
+		msgs[i].len = rp_hdrs[i]->len;
+		msgs[i].src = rp_hdrs[i]->src;
+	}
+
+	status = ept->batch_cb(ept, msgs, num, ept->priv);
+
+	RPMSG_ASSERT(status >= 0, "unexpected callback status\r\n");
+}
+
+/**
+ * @internal
+ *
+ * @brief Queues a held rx buffer on its endpoint for a deferred dispatch or
+ * read.
+ *
+ * Called under the rpmsg device lock, with an endpoint reference taken for
+ * the message.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device
+ * @param queue		Queue pair the buffer belongs to
+ * @param ept		Pointer to the destination endpoint
+ * @param rp_hdr	Header of the received message
+ * @param idx		Buffer index
+ *
+ * @return true if the endpoint became ready and the workers have to be woken
+ */
+static bool rpmsg_virtio_rx_queue_msg(struct rpmsg_virtio_device *rvdev,
+				      struct rpmsg_virtio_queue *queue,
+				      struct rpmsg_endpoint *ept,
+				      struct rpmsg_hdr *rp_hdr, uint16_t idx)
+{
+	struct rpmsg_rx_msg *msg = &queue->rx_msgs[idx];
+
+	msg->hdr = rp_hdr;
+	metal_list_add_tail(&ept->rx_msgs, &msg->node);
+
+	/*
+	 * Endpoints without callback are read with rpmsg_recv_nocopy(), and a
+	 * running endpoint is dispatched until its queue is empty.
+	 */
+	if (!ept->cb || ept->rx_ready || ept->rx_running)
+		return false;
+
+	ept->rx_ready = true;
+	metal_list_add_tail(&rvdev->rx_ready, &ept->rx_node);
+
+	return true;
+}
+
+/**
+ * @internal
+ *
+ * @brief Enables the rx notifications of a queue pair.
+ *
+ * With moderation, a busy queue pair asks to be notified every notify_max_bufs
+ * messages and relies on the moderation timer for the others, an idle one
+ * asks to be notified for each message. Called under the rx lock of the queue
+ * pair.
+ *
+ * @param rvdev	Pointer to rpmsg virtio device
+ * @param queue	Queue pair to enable the notifications of
+ * @param busy	Whether messages were received since the last notification
+ *
+ * @return 1 if messages are already pending, 0 otherwise
+ */
+static int rpmsg_virtio_rx_enable_cb(struct rpmsg_virtio_device *rvdev,
+				     struct rpmsg_virtio_queue *queue,
+				     bool busy)
+{
+	uint16_t thresh = 0;
+
+	if (queue->rx_max_bufs && busy) {
+		thresh = queue->rx_max_bufs;
+		rpmsg_virtio_start_notify_timer(rvdev);
+	}
+	virtqueue_set_notify_threshold(queue->rvq, thresh);
+
+	return virtqueue_enable_cb(queue->rvq);
+}
+
+/** @internal Rx buffers given back in batches by rpmsg_virtio_rx_process() */
+struct rpmsg_virtio_rx_rel {
+	/** Buffers to give back */
+	struct rpmsg_hdr *hdrs[RPMSG_VIRTIO_BATCH_SIZE];
+
+	/** Number of buffers to give back */
+	int num;
+
+	/** Number of buffers given back at once */
+	int max;
+
+	/** Whether buffers were given back without kicking the peer */
+	bool kick;
+};
+
+/**
+ * @internal
+ *
+ * @brief Drops the hold of rx_process on delivered rx buffers.
+ *
+ * The buffers not held by the endpoint are given back to the peer in batches.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device
+ * @param queue		Queue pair the buffers belong to
+ * @param rel		Buffers waiting to be given back
+ * @param rp_hdrs	Headers of the delivered buffers
+ * @param num		Number of delivered buffers
+ */
+static void rpmsg_virtio_rx_put(struct rpmsg_virtio_device *rvdev,
+				struct rpmsg_virtio_queue *queue,
+				struct rpmsg_virtio_rx_rel *rel,
+				struct rpmsg_hdr **rp_hdrs, int num)
+{
+	int i;
+
+	metal_mutex_acquire(&queue->rx_lock);
+	for (i = 0; i < num; i++) {
+		if (rpmsg_virtio_buf_held_dec_test(rp_hdrs[i]))
+			rel->hdrs[rel->num++] = rp_hdrs[i];
+		if (rel->num < rel->max)
+			continue;
+		rpmsg_virtio_return_buffers(rvdev, queue, rel->hdrs, rel->num);
+		rel->num = 0;
+		if (VIRTIO_ENABLED(VQ_RX_EMPTY_NOTIFY))
+			/* Kick will be sent only when last buffer is released */
+			rel->kick = true;
+		else
+			/* Tell peer we returned rx buffers */
+			virtqueue_kick(queue->rvq);
+	}
+	metal_mutex_release(&queue->rx_lock);
+}
+
+/**
+ * @internal
+ *
+ * @brief Delivers a batch of messages to their endpoint and drops their hold.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device
+ * @param queue		Queue pair the buffers belong to
+ * @param rel		Buffers waiting to be given back
+ * @param ept		Pointer to the destination endpoint, referenced once
+ * @param rp_hdrs	Headers of the received messages
+ * @param num		Number of messages
+ */
+static void rpmsg_virtio_rx_flush_batch(struct rpmsg_virtio_device *rvdev,
+					struct rpmsg_virtio_queue *queue,
+					struct rpmsg_virtio_rx_rel *rel,
+					struct rpmsg_endpoint *ept,
+					struct rpmsg_hdr **rp_hdrs, int num)
+{
+	rpmsg_virtio_rx_deliver_batch(ept, rp_hdrs, num);
+
+	metal_mutex_acquire(&rvdev->rdev.lock);
+	rpmsg_ept_decref(ept);
+	metal_mutex_release(&rvdev->rdev.lock);
+
+	rpmsg_virtio_rx_put(rvdev, queue, rel, rp_hdrs, num);
+}
+
+/**
+ * @internal
+ *
+ * @brief Processes the messages received on a queue pair.
+ *
+ * @param rvdev		Pointer to rpmsg virtio device
+ * @param queue		Queue pair to process
+ * @param budget	Maximum number of messages to process
+ *
+ * @return Number of messages processed
+ */
+static int rpmsg_virtio_rx_process(struct rpmsg_virtio_device *rvdev,
+				   struct rpmsg_virtio_queue *queue, int budget)
+{
+	struct rpmsg_device *rdev = &rvdev->rdev;
+	struct virtqueue *vq = queue->rvq;
+	unsigned int qid = queue - rvdev->queues;
+	struct rpmsg_hdr *batch[RPMSG_VIRTIO_BATCH_SIZE];
+	struct rpmsg_endpoint *batch_ept = NULL;
+	struct rpmsg_virtio_rx_rel rel;
+	struct rpmsg_endpoint *ept;
+	struct rpmsg_hdr *rp_hdr;
+	bool wake = false;
+	int count = 0;
+	int nbatch = 0;
+	uint32_t len;
+	uint16_t idx;
+
+	/*
+	 * Released buffers are given back in batches, but never hold more than
+	 * half of the ring so that the peer can keep sending meanwhile.
+	 */
+	rel.num = 0;
+	rel.max = metal_min(RPMSG_VIRTIO_BATCH_SIZE, vq->vq_nentries / 2);
+	rel.max = metal_max(rel.max, 1);
+	rel.kick = false;
+
+	while (1) {
+		/* Process the received data from remote node */
+		metal_mutex_acquire(&queue->rx_lock);
+		rp_hdr = NULL;
+		if (count < budget)
+			rp_hdr = rpmsg_virtio_get_rx_buffer(rvdev, queue, &len,
+							    &idx);
+
+		/* Deliver the pending batch before giving the buffers back */
+		if (!rp_hdr && nbatch) {
+			metal_mutex_release(&queue->rx_lock);
+			rpmsg_virtio_rx_flush_batch(rvdev, queue, &rel,
+						    batch_ept, batch, nbatch);
+			nbatch = 0;
+			continue;
+		}
+
+		/* No more filled rx buffers, or budget exhausted */
+		if (!rp_hdr) {
+			if (rel.num) {
+				rpmsg_virtio_return_buffers(rvdev, queue,
+							    rel.hdrs, rel.num);
+				rel.kick = true;
+			}
+			if (rel.kick)
+				/* Tell peer we returned some rx buffer */
+				virtqueue_kick(queue->rvq);
+			/* Moderated notifications have to be requested again */
+			if (count < budget && queue->rx_max_bufs &&
+			    !queue->rx_polling &&
+			    rpmsg_virtio_rx_enable_cb(rvdev, queue, count > 0)) {
+				metal_mutex_release(&queue->rx_lock);
+				rel.num = 0;
+				rel.kick = false;
+				continue;
+			}
+			metal_mutex_release(&queue->rx_lock);
+			break;
+		}
+
+		count++;
+		rp_hdr->reserved = RPMSG_BUF_RESERVED(idx, qid);
+		RPMSG_BUF_HELD_INC(rp_hdr);
+		metal_mutex_release(&queue->rx_lock);
+
+		/* Get the channel node from the remote device channels list. */
+		metal_mutex_acquire(&rdev->lock);
+		ept = rpmsg_get_ept_from_addr(rdev, rp_hdr->dst);
+		/* Fragments are dropped unless the endpoint expects them */
+		if (ept && (rp_hdr->flags & RPMSG_HDR_F_FRAG) && !ept->frag) {
+			metal_warn("dropped fragment for ept 0x%x\r\n",
+				   (unsigned int)ept->addr);
+			ept = NULL;
+		}
+		rpmsg_ept_incref(ept);
+		/*
+		 * Deferred dispatch or read: the buffer stays held until then.
+		 * The messages of an endpoint still dispatched since the
+		 * deferred mode was left are queued as well, to keep their order.
+		 */
+		if (ept && (rvdev->dispatch_cb || !ept->cb || ept->rx_ready ||
+			    ept->rx_running)) {
+			if (rpmsg_virtio_rx_queue_msg(rvdev, queue, ept, rp_hdr,
+						      idx))
+				wake = true;
+			metal_mutex_release(&rdev->lock);
+			continue;
+		}
+		metal_mutex_release(&rdev->lock);
+
+		/* Only consecutive messages of an endpoint are batched */
+		if (nbatch && (ept != batch_ept ||
+			       !rpmsg_virtio_rx_batchable(ept, rp_hdr))) {
+			rpmsg_virtio_rx_flush_batch(rvdev, queue, &rel,
+						    batch_ept, batch, nbatch);
+			nbatch = 0;
+		}
+
+		if (ept && rpmsg_virtio_rx_batchable(ept, rp_hdr)) {
+			if (nbatch) {
+				/* The batch holds a single reference */
+				metal_mutex_acquire(&rdev->lock);
+				rpmsg_ept_decref(ept);
+				metal_mutex_release(&rdev->lock);
+			}
+			batch_ept = ept;
+			batch[nbatch++] = rp_hdr;
+			if (nbatch == RPMSG_VIRTIO_BATCH_SIZE) {
+				rpmsg_virtio_rx_flush_batch(rvdev, queue, &rel,
+							    ept, batch, nbatch);
+				nbatch = 0;
+			}
+			continue;
+		}
+
+		if (ept) {
+			rpmsg_virtio_rx_deliver(rvdev, ept, rp_hdr);
+
+			metal_mutex_acquire(&rdev->lock);
+			rpmsg_ept_decref(ept);
+			metal_mutex_release(&rdev->lock);
+		}
 
-	/* Get the payload buffer. */
-	buffer = rpmsg_virtio_get_tx_payload_buffer(rdev, &buff_len, wait);
-	if (!buffer)
-		return RPMSG_ERR_NO_BUFF;
+		rpmsg_virtio_rx_put(rvdev, queue, &rel, &rp_hdr, 1);
+	}
 
-	/* Copy data to rpmsg buffer. */
-	if (len > (int)buff_len)
-		len = buff_len;
-	io = rvdev->shbuf_io;
-	status = metal_io_block_write(io, metal_io_virt_to_offset(io, buffer),
-				      data, len);
-	RPMSG_ASSERT(status == len, "failed to write buffer\r\n");
+	if (wake)
+		rvdev->dispatch_cb(rdev);
 
-	return rpmsg_virtio_send_offchannel_nocopy(rdev, src, dst, buffer, len);
+	return count;
 }
 
 /**
  * @internal
  *
- * @brief Tx callback function.
+ * @brief Handles an rx notification of a queue pair.
  *
- * @param vq	Pointer to virtqueue on which Tx is has been
- *		completed.
+ * With an rx budget set, a notification processing a full budget of messages
+ * disables the rx notifications and leaves the remaining messages to
+ * rpmsg_virtio_poll().
+ *
+ * @param rvdev	Pointer to rpmsg virtio device
+ * @param queue	Queue pair notified
  */
-static void rpmsg_virtio_tx_callback(struct virtqueue *vq)
+static void rpmsg_virtio_rx_notified(struct rpmsg_virtio_device *rvdev,
+				     struct rpmsg_virtio_queue *queue)
 {
-	(void)vq;
+	struct rpmsg_device *rdev = &rvdev->rdev;
+	rpmsg_virtio_rx_poll_cb poll_cb;
+	int budget;
+
+	/* Read as a pair, a budget is never used without its poll callback */
+	metal_mutex_acquire(&rdev->lock);
+	budget = rvdev->rx_budget;
+	poll_cb = rvdev->rx_poll_cb;
+	metal_mutex_release(&rdev->lock);
+
+	if (!budget) {
+		rpmsg_virtio_rx_process(rvdev, queue, INT32_MAX);
+		return;
+	}
+
+	if (rpmsg_virtio_rx_process(rvdev, queue, budget) < budget)
+		return;
+
+	/* Under load, switch to polling */
+	metal_mutex_acquire(&queue->rx_lock);
+	virtqueue_disable_cb(queue->rvq);
+	queue->rx_polling = true;
+	metal_mutex_release(&queue->rx_lock);
+
+	poll_cb(rdev);
 }
 
 /**
@@ -558,64 +2160,9 @@ static void rpmsg_virtio_rx_callback(struct virtqueue *vq)
 {
 	struct virtio_device *vdev = vq->vq_dev;
 	struct rpmsg_virtio_device *rvdev = vdev->priv;
-	struct rpmsg_device *rdev = &rvdev->rdev;
-	struct rpmsg_endpoint *ept;
-	struct rpmsg_hdr *rp_hdr;
-	bool release = false;
-	uint32_t len;
-	uint16_t idx;
-	int status;
+	unsigned int qid = vq->vq_queue_index / RPMSG_NUM_VRINGS;
 
-	while (1) {
-		/* Process the received data from remote node */
-		metal_mutex_acquire(&rdev->lock);
-		rp_hdr = rpmsg_virtio_get_rx_buffer(rvdev, &len, &idx);
-
-		/* No more filled rx buffers */
-		if (!rp_hdr) {
-			if (VIRTIO_ENABLED(VQ_RX_EMPTY_NOTIFY) && release)
-				/* Tell peer we returned some rx buffer */
-				virtqueue_kick(rvdev->rvq);
-			metal_mutex_release(&rdev->lock);
-			break;
-		}
-
-		rp_hdr->reserved = idx;
-
-		/* Get the channel node from the remote device channels list. */
-		ept = rpmsg_get_ept_from_addr(rdev, rp_hdr->dst);
-		rpmsg_ept_incref(ept);
-		RPMSG_BUF_HELD_INC(rp_hdr);
-		metal_mutex_release(&rdev->lock);
-
-		if (ept) {
-			if (ept->dest_addr == RPMSG_ADDR_ANY) {
-				/*
-				 * First message received from the remote side,
-				 * update channel destination address
-				 */
-				ept->dest_addr = rp_hdr->src;
-			}
-			status = ept->cb(ept, RPMSG_LOCATE_DATA(rp_hdr),
-					 rp_hdr->len, rp_hdr->src, ept->priv);
-
-			RPMSG_ASSERT(status >= 0,
-				     "unexpected callback status\r\n");
-		}
-
-		metal_mutex_acquire(&rdev->lock);
-		rpmsg_ept_decref(ept);
-		if (rpmsg_virtio_buf_held_dec_test(rp_hdr)) {
-			rpmsg_virtio_release_rx_buffer_nolock(rvdev, rp_hdr);
-			if (VIRTIO_ENABLED(VQ_RX_EMPTY_NOTIFY))
-				/* Kick will be sent only when last buffer is released */
-				release = true;
-			else
-				/* Tell peer we returned an rx buffer */
-				virtqueue_kick(rvdev->rvq);
-		}
-		metal_mutex_release(&rdev->lock);
-	}
+	rpmsg_virtio_rx_notified(rvdev, &rvdev->queues[qid]);
 }
 
 /**
@@ -775,6 +2322,43 @@ int rpmsg_virtio_get_rx_buffer_size(struct rpmsg_device *rdev)
 	return size;
 }
 
+#if VIRTIO_ENABLED(VIRTIO_DRIVER_SUPPORT)
+/**
+ * @internal
+ *
+ * @brief Returns the buffers of the virtqueues to the shared memory pools.
+ *
+ * The buffers still attached to a descriptor, including the used buffers
+ * not yet retrieved, and the tx buffers of the reclaimers are freed.
+ *
+ * @param rvdev	Pointer to rpmsg virtio device
+ */
+static void rpmsg_virtio_free_buffers(struct rpmsg_virtio_device *rvdev)
+{
+	struct rpmsg_virtio_queue *queue;
+	struct vbuff_reclaimer_t *r_desc;
+	unsigned int i;
+	uint16_t idx;
+
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		for (idx = 0; idx < queue->rvq->vq_nentries; idx++) {
+			rpmsg_virtio_shm_pool_free_buffer(rvdev->rx_shpool,
+							  queue->rvq->vq_descx[idx].cookie,
+							  rvdev->config.r2h_buf_size);
+		}
+		for (idx = 0; idx < queue->svq->vq_nentries; idx++) {
+			rpmsg_virtio_shm_pool_free_buffer(rvdev->shpool,
+							  queue->svq->vq_descx[idx].cookie,
+							  rvdev->config.h2r_buf_size);
+		}
+		while ((r_desc = rpmsg_virtio_reclaimer_pop(queue)))
+			rpmsg_virtio_shm_pool_free_buffer(rvdev->shpool, r_desc,
+							  rvdev->config.h2r_buf_size);
+	}
+}
+#endif
+
 int rpmsg_init_vdev(struct rpmsg_virtio_device *rvdev,
 		    struct virtio_device *vdev,
 		    rpmsg_ns_bind_cb ns_bind_cb,
@@ -793,17 +2377,29 @@ int rpmsg_init_vdev_with_config(struct rpmsg_virtio_device *rvdev,
 				const struct rpmsg_virtio_config *config)
 {
 	struct rpmsg_device *rdev;
-	const char *vq_names[RPMSG_NUM_VRINGS];
-	vq_callback callback[RPMSG_NUM_VRINGS];
+	const char *vq_names[RPMSG_NUM_VRINGS * RPMSG_VIRTIO_MAX_QUEUES];
+	vq_callback callback[RPMSG_NUM_VRINGS * RPMSG_VIRTIO_MAX_QUEUES];
+	struct rpmsg_virtio_queue *queue;
+	unsigned int i, num_vrings;
 	uint32_t features;
 	int status;
-	unsigned int i;
 
 	if (!rvdev || !vdev || !shm_io)
 		return RPMSG_ERR_PARAM;
 
 	rdev = &rvdev->rdev;
 	rvdev->notify_wait_cb = NULL;
+	rvdev->tx_wait_cb = NULL;
+	rvdev->tx_wake_cb = NULL;
+	rvdev->tx_kick_batch = 0;
+	rvdev->rx_budget = 0;
+	rvdev->rx_poll_cb = NULL;
+	rvdev->notify_max_bufs = 0;
+	rvdev->notify_timer_cb = NULL;
+	rvdev->notify_timer_armed = false;
+	rvdev->dispatch_cb = NULL;
+	metal_list_init(&rvdev->rx_ready);
+	rvdev->tx_timeout_us = RPMSG_TICK_COUNT;
 	memset(rdev, 0, sizeof(*rdev));
 	metal_mutex_init(&rdev->lock);
 	rvdev->vdev = vdev;
@@ -813,10 +2409,18 @@ int rpmsg_init_vdev_with_config(struct rpmsg_virtio_device *rvdev,
 	rdev->ops.hold_rx_buffer = rpmsg_virtio_hold_rx_buffer;
 	rdev->ops.release_rx_buffer = rpmsg_virtio_release_rx_buffer;
 	rdev->ops.get_tx_payload_buffer = rpmsg_virtio_get_tx_payload_buffer;
+	rdev->ops.get_tx_payload_buffers = rpmsg_virtio_get_tx_payload_buffers;
 	rdev->ops.send_offchannel_nocopy = rpmsg_virtio_send_offchannel_nocopy;
 	rdev->ops.release_tx_buffer = rpmsg_virtio_release_tx_buffer;
 	rdev->ops.get_rx_buffer_size = rpmsg_virtio_get_rx_buffer_size;
 	rdev->ops.get_tx_buffer_size = rpmsg_virtio_get_tx_buffer_size;
+	rdev->ops.flush = rpmsg_virtio_flush;
+	rdev->ops.sendv_offchannel_raw = rpmsg_virtio_sendv_offchannel_raw;
+	rdev->ops.recv_nocopy = rpmsg_virtio_recv_nocopy;
+	rdev->ops.enable_recv_nocopy = rpmsg_virtio_enable_recv_nocopy;
+	rdev->ops.send_offchannel_batch = rpmsg_virtio_send_offchannel_batch;
+	rdev->ops.send_offchannel_nocopy_batch =
+		rpmsg_virtio_send_offchannel_nocopy_batch;
 
 	if (VIRTIO_ROLE_IS_DRIVER(vdev)) {
 		/*
@@ -840,6 +2444,7 @@ int rpmsg_init_vdev_with_config(struct rpmsg_virtio_device *rvdev,
 	if (status)
 		return status;
 	rdev->support_ns = !!(features & (1 << VIRTIO_RPMSG_F_NS));
+	rdev->support_frag = !!(features & (1 << VIRTIO_RPMSG_F_FRAG));
 
 	if (VIRTIO_ROLE_IS_DRIVER(vdev)) {
 		/*
@@ -847,52 +2452,81 @@ int rpmsg_init_vdev_with_config(struct rpmsg_virtio_device *rvdev,
 		 * shared buffers. Create shared memory pool to handle buffers.
 		 */
 		rvdev->shpool = config->split_shpool ? shpool + 1 : shpool;
+		rvdev->rx_shpool = shpool;
 		if (!shpool)
 			return RPMSG_ERR_PARAM;
 		if (!shpool->size || !rvdev->shpool->size)
 			return RPMSG_ERR_NO_BUFF;
-
-		vq_names[0] = "rx_vq";
-		vq_names[1] = "tx_vq";
-		callback[0] = rpmsg_virtio_rx_callback;
-		callback[1] = rpmsg_virtio_tx_callback;
 	}
 
-	if (VIRTIO_ROLE_IS_DEVICE(vdev)) {
-		vq_names[0] = "tx_vq";
-		vq_names[1] = "rx_vq";
-		callback[0] = rpmsg_virtio_tx_callback;
-		callback[1] = rpmsg_virtio_rx_callback;
+	/*
+	 * Each pair of vrings declared by the virtio device is a queue pair,
+	 * endpoints are spread over them to isolate their traffic.
+	 */
+	rvdev->num_queues = metal_min(vdev->vrings_num / RPMSG_NUM_VRINGS,
+				      RPMSG_VIRTIO_MAX_QUEUES);
+	rvdev->num_queues = metal_max(rvdev->num_queues, 1U);
+	num_vrings = rvdev->num_queues * RPMSG_NUM_VRINGS;
+
+	for (i = 0; i < num_vrings; i++) {
+		/* The driver receives on even vrings, the device on odd ones */
+		bool rx = !(i % RPMSG_NUM_VRINGS);
+
+		if (VIRTIO_ROLE_IS_DEVICE(vdev))
+			rx = !rx;
+		if (rx) {
+			vq_names[i] = "rx_vq";
+			callback[i] = rpmsg_virtio_rx_callback;
+		} else {
+			vq_names[i] = "tx_vq";
+			callback[i] = rpmsg_virtio_tx_callback;
+		}
 	}
 
 	rvdev->shbuf_io = shm_io;
-	metal_list_init(&rvdev->reclaimer);
 
 	/* Create virtqueues for remote device */
-	status = virtio_create_virtqueues(vdev, 0, RPMSG_NUM_VRINGS,
+	status = virtio_create_virtqueues(vdev, 0, num_vrings,
 					  vq_names, callback, NULL);
 	if (status != RPMSG_SUCCESS)
 		return status;
 
-	/* Create virtqueue success, assign back the virtqueue */
-	if (VIRTIO_ROLE_IS_DRIVER(vdev)) {
-		rvdev->rvq  = vdev->vrings_info[0].vq;
-		rvdev->svq  = vdev->vrings_info[1].vq;
-	}
+	/* Create virtqueue success, assign back the virtqueues */
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		if (VIRTIO_ROLE_IS_DRIVER(vdev)) {
+			queue->rvq = vdev->vrings_info[RPMSG_NUM_VRINGS * i].vq;
+			queue->svq = vdev->vrings_info[RPMSG_NUM_VRINGS * i + 1].vq;
+		}
 
-	if (VIRTIO_ROLE_IS_DEVICE(vdev)) {
-		rvdev->rvq  = vdev->vrings_info[1].vq;
-		rvdev->svq  = vdev->vrings_info[0].vq;
-	}
+		if (VIRTIO_ROLE_IS_DEVICE(vdev)) {
+			queue->rvq = vdev->vrings_info[RPMSG_NUM_VRINGS * i + 1].vq;
+			queue->svq = vdev->vrings_info[RPMSG_NUM_VRINGS * i].vq;
+		}
+		metal_mutex_init(&queue->tx_lock);
+		metal_mutex_init(&queue->rx_lock);
+		/* Allocated on demand, see rpmsg_virtio_alloc_rx_msgs() */
+		queue->rx_msgs = NULL;
+		atomic_store(&queue->reclaimer, 0);
+		queue->tx_bufs = 0;
+		queue->tx_waiters = 0;
+		queue->rx_polling = false;
+		queue->tx_max_bufs = 0;
+		queue->rx_max_bufs = 0;
+		queue->tx_flushed = 0;
+		queue->rx_invalidated = 0;
 
-	/*
-	 * Suppress "tx-complete" interrupts
-	 * since send method use busy loop when buffer pool exhaust
-	 */
-	virtqueue_disable_cb(rvdev->svq);
+		/*
+		 * Suppress "tx-complete" interrupts
+		 * since send method use busy loop when buffer pool exhaust
+		 */
+		virtqueue_disable_cb(queue->svq);
+	}
+	rvdev->rvq = rvdev->queues[0].rvq;
+	rvdev->svq = rvdev->queues[0].svq;
 
 	/* TODO: can have a virtio function to set the shared memory I/O */
-	for (i = 0; i < RPMSG_NUM_VRINGS; i++) {
+	for (i = 0; i < num_vrings; i++) {
 		struct virtqueue *vq;
 
 		vq = vdev->vrings_info[i].vq;
@@ -900,34 +2534,12 @@ int rpmsg_init_vdev_with_config(struct rpmsg_virtio_device *rvdev,
 	}
 
 	if (VIRTIO_ROLE_IS_DRIVER(vdev)) {
-		struct virtqueue_buf vqbuf;
-		unsigned int idx;
-		void *buffer;
-
-		vqbuf.len = rvdev->config.r2h_buf_size;
-		for (idx = 0; idx < rvdev->rvq->vq_nentries; idx++) {
-			/* Initialize TX virtqueue buffers for remote device */
-			buffer = rpmsg_virtio_shm_pool_get_buffer(shpool,
-					rvdev->config.r2h_buf_size);
-
-			if (!buffer) {
-				status = RPMSG_ERR_NO_BUFF;
-				goto err;
-			}
-
-			vqbuf.buf = buffer;
-
-			metal_io_block_set(shm_io,
-					   metal_io_virt_to_offset(shm_io,
-								   buffer),
-					   0x00, rvdev->config.r2h_buf_size);
-			status =
-				virtqueue_add_buffer(rvdev->rvq, &vqbuf, 0, 1,
-						     buffer);
-
-			if (status != RPMSG_SUCCESS) {
+		for (i = 0; i < rvdev->num_queues; i++) {
+			status = rpmsg_virtio_fill_rx_queue(rvdev,
+							    &rvdev->queues[i],
+							    shpool);
+			if (status != RPMSG_SUCCESS)
 				goto err;
-			}
 		}
 	}
 
@@ -947,13 +2559,27 @@ int rpmsg_init_vdev_with_config(struct rpmsg_virtio_device *rvdev,
 	if (VIRTIO_ROLE_IS_DRIVER(vdev)) {
 		status = virtio_set_status(vdev, VIRTIO_CONFIG_STATUS_DRIVER_OK);
 		if (status)
-			goto err;
+			goto err_ns;
 	}
 
 	return RPMSG_SUCCESS;
 
+err_ns:
+	if (rdev->support_ns)
+		rpmsg_destroy_ept(&rdev->ns_ept);
 err:
+#if VIRTIO_ENABLED(VIRTIO_DRIVER_SUPPORT)
+	if (VIRTIO_ROLE_IS_DRIVER(vdev))
+		rpmsg_virtio_free_buffers(rvdev);
+#endif
+	for (i = 0; i < rvdev->num_queues; i++) {
+		metal_mutex_deinit(&rvdev->queues[i].tx_lock);
+		metal_mutex_deinit(&rvdev->queues[i].rx_lock);
+	}
+	memset(rvdev->queues, 0, sizeof(rvdev->queues));
+	rvdev->num_queues = 0;
 	virtio_delete_virtqueues(vdev);
+	metal_mutex_deinit(&rdev->lock);
 	return status;
 }
 
@@ -962,6 +2588,7 @@ void rpmsg_deinit_vdev(struct rpmsg_virtio_device *rvdev)
 	struct metal_list *node;
 	struct rpmsg_device *rdev;
 	struct rpmsg_endpoint *ept;
+	unsigned int i;
 
 	if (rvdev) {
 		rdev = &rvdev->rdev;
@@ -971,11 +2598,365 @@ void rpmsg_deinit_vdev(struct rpmsg_virtio_device *rvdev)
 			rpmsg_destroy_ept(ept);
 		}
 
+#if VIRTIO_ENABLED(VIRTIO_DRIVER_SUPPORT)
+		if (VIRTIO_ROLE_IS_DRIVER(rvdev->vdev))
+			rpmsg_virtio_free_buffers(rvdev);
+#endif
+
+		for (i = 0; i < rvdev->num_queues; i++) {
+			metal_mutex_deinit(&rvdev->queues[i].tx_lock);
+			metal_mutex_deinit(&rvdev->queues[i].rx_lock);
+			metal_free_memory(rvdev->queues[i].rx_msgs);
+		}
+		rvdev->dispatch_cb = NULL;
+
 		rvdev->rvq = 0;
 		rvdev->svq = 0;
+		memset(rvdev->queues, 0, sizeof(rvdev->queues));
+		rvdev->num_queues = 0;
 
 		virtio_delete_virtqueues(rvdev->vdev);
 		metal_mutex_deinit(&rdev->lock);
 		rvdev->vdev = NULL;
 	}
 }
+
+int rpmsg_virtio_poll(struct rpmsg_device *rdev, int budget)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
+	unsigned int i;
+	int done = 0;
+
+	if (!rdev || budget <= 0)
+		return RPMSG_ERR_PARAM;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+
+	for (i = 0; i < rvdev->num_queues && done < budget; i++)
+		done += rpmsg_virtio_rx_process(rvdev, &rvdev->queues[i],
+						budget - done);
+	if (done == budget)
+		return done;
+
+	/* All the rings are drained, switch back to notifications */
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		metal_mutex_acquire(&queue->rx_lock);
+		if (queue->rx_polling) {
+			queue->rx_polling = false;
+			if (rpmsg_virtio_rx_enable_cb(rvdev, queue, true)) {
+				/* Messages arrived meanwhile, keep polling */
+				virtqueue_disable_cb(queue->rvq);
+				queue->rx_polling = true;
+				done = budget;
+			}
+		}
+		metal_mutex_release(&queue->rx_lock);
+	}
+
+	return done;
+}
+
+int rpmsg_virtio_set_rx_dispatch(struct rpmsg_virtio_device *rvdev,
+				 rpmsg_virtio_dispatch_cb dispatch_cb)
+{
+	int status = RPMSG_SUCCESS;
+	int count;
+
+	if (!rvdev || !rvdev->vdev)
+		return RPMSG_ERR_PARAM;
+
+	metal_mutex_acquire(&rvdev->rdev.lock);
+	if (dispatch_cb)
+		status = rpmsg_virtio_alloc_rx_msgs(rvdev);
+	if (!status)
+		rvdev->dispatch_cb = dispatch_cb;
+	metal_mutex_release(&rvdev->rdev.lock);
+
+	/*
+	 * Nothing wakes the workers anymore: deliver the messages still waiting
+	 * for them, their buffers would stay held otherwise.
+	 */
+	if (!status && !dispatch_cb) {
+		do {
+			count = rpmsg_virtio_dispatch(&rvdev->rdev,
+						      RPMSG_VIRTIO_BATCH_SIZE);
+		} while (count > 0);
+	}
+
+	return status;
+}
+
+int rpmsg_virtio_dispatch(struct rpmsg_device *rdev, int budget)
+{
+	struct rpmsg_hdr *batch[RPMSG_VIRTIO_BATCH_SIZE];
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_endpoint *ept = NULL;
+	struct rpmsg_rx_msg *msg;
+	struct metal_list *node;
+	int count = 0;
+	bool done;
+	int num, i;
+
+	if (!rdev || budget <= 0)
+		return RPMSG_ERR_PARAM;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+
+	metal_mutex_acquire(&rdev->lock);
+	while (count < budget) {
+		if (!ept) {
+			/* Take the next endpoint no worker is dispatching */
+			node = metal_list_first(&rvdev->rx_ready);
+			if (!node)
+				break;
+			metal_list_del(node);
+			ept = metal_container_of(node, struct rpmsg_endpoint,
+						 rx_node);
+			ept->rx_ready = false;
+			ept->rx_running = true;
+		}
+
+		/* Take the next messages a batch callback accepts together */
+		num = 0;
+		while (num < RPMSG_VIRTIO_BATCH_SIZE && count + num < budget) {
+			node = metal_list_first(&ept->rx_msgs);
+			if (!node)
+				break;
+			msg = metal_container_of(node, struct rpmsg_rx_msg,
+						 node);
+			if (num && !rpmsg_virtio_rx_batchable(ept, msg->hdr))
+				break;
+			metal_list_del(node);
+			batch[num++] = msg->hdr;
+			if (!rpmsg_virtio_rx_batchable(ept, msg->hdr))
+				break;
+		}
+		if (!num) {
+			ept->rx_running = false;
+			ept = NULL;
+			continue;
+		}
+		metal_mutex_release(&rdev->lock);
+
+		if (rpmsg_virtio_rx_batchable(ept, batch[0]))
+			rpmsg_virtio_rx_deliver_batch(ept, batch, num);
+		else
+			rpmsg_virtio_rx_deliver(rvdev, ept, batch[0]);
+		for (i = 0; i < num; i++)
+			rpmsg_virtio_release_rx_buffer(rdev,
+						       RPMSG_LOCATE_DATA(batch[i]));
+		count += num;
+
+		metal_mutex_acquire(&rdev->lock);
+		/*
+		 * The reference of the message may be the last one, once the
+		 * endpoint is destroyed: leave it before dropping the reference.
+		 */
+		done = metal_list_is_empty(&ept->rx_msgs);
+		if (done)
+			ept->rx_running = false;
+		for (i = 0; i < num; i++)
+			rpmsg_ept_decref(ept);
+		if (done)
+			ept = NULL;
+	}
+
+	/* Budget exhausted, give the endpoint back to any worker */
+	if (ept) {
+		ept->rx_running = false;
+		ept->rx_ready = true;
+		metal_list_add_tail(&rvdev->rx_ready, &ept->rx_node);
+	}
+	if (!metal_list_is_empty(&rvdev->rx_ready))
+		count = budget;
+	metal_mutex_release(&rdev->lock);
+
+	return count;
+}
+
+int rpmsg_virtio_set_rx_budget(struct rpmsg_virtio_device *rvdev, int budget,
+			       rpmsg_virtio_rx_poll_cb poll_cb)
+{
+	struct rpmsg_device *rdev;
+
+	/* Nothing would poll the queues once the rx notifications disabled */
+	if (!rvdev || budget < 0 || (budget && !poll_cb))
+		return RPMSG_ERR_PARAM;
+
+	rdev = &rvdev->rdev;
+	metal_mutex_acquire(&rdev->lock);
+	rvdev->rx_budget = budget;
+	rvdev->rx_poll_cb = poll_cb;
+	metal_mutex_release(&rdev->lock);
+
+	return RPMSG_SUCCESS;
+}
+
+int rpmsg_virtio_set_notify_moderation(struct rpmsg_virtio_device *rvdev,
+				       uint16_t max_bufs, uint32_t timeout_us,
+				       rpmsg_virtio_notify_timer_cb timer_cb)
+{
+	struct rpmsg_virtio_queue *queue;
+	struct rpmsg_device *rdev;
+	bool pending = false;
+	unsigned int i;
+
+	if (!rvdev)
+		return RPMSG_ERR_PARAM;
+	if (max_bufs <= 1) {
+		max_bufs = 0;
+	} else {
+		if (!timer_cb)
+			return RPMSG_ERR_PARAM;
+		if (!(rvdev->vdev->features & VIRTIO_RING_F_EVENT_IDX))
+			return RPMSG_ERR_PERM;
+	}
+
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		if (max_bufs > queue->rvq->vq_nentries ||
+		    max_bufs > queue->svq->vq_nentries)
+			return RPMSG_ERR_PARAM;
+	}
+
+	rdev = &rvdev->rdev;
+	metal_mutex_acquire(&rdev->lock);
+	rvdev->notify_max_bufs = max_bufs;
+	rvdev->notify_timeout_us = timeout_us;
+	rvdev->notify_timer_cb = timer_cb;
+	metal_mutex_release(&rdev->lock);
+
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		metal_mutex_acquire(&queue->tx_lock);
+		queue->tx_max_bufs = max_bufs;
+		virtqueue_set_notify_threshold(queue->svq, max_bufs);
+		metal_mutex_release(&queue->tx_lock);
+
+		/* Start from a notification per message */
+		metal_mutex_acquire(&queue->rx_lock);
+		queue->rx_max_bufs = max_bufs;
+		if (!queue->rx_polling &&
+		    rpmsg_virtio_rx_enable_cb(rvdev, queue, false))
+			pending = true;
+		metal_mutex_release(&queue->rx_lock);
+	}
+
+	for (i = 0; pending && i < rvdev->num_queues; i++)
+		rpmsg_virtio_rx_notified(rvdev, &rvdev->queues[i]);
+
+	return RPMSG_SUCCESS;
+}
+
+void rpmsg_virtio_notify_timeout(struct rpmsg_device *rdev)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
+	bool polling, wake = false;
+	unsigned int i;
+
+	if (!rdev)
+		return;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+	metal_mutex_acquire(&rdev->lock);
+	rvdev->notify_timer_armed = false;
+	metal_mutex_release(&rdev->lock);
+
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		metal_mutex_acquire(&queue->tx_lock);
+		if (queue->tx_waiters)
+			wake = true;
+		metal_mutex_release(&queue->tx_lock);
+	}
+
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		metal_mutex_acquire(&queue->rx_lock);
+		polling = queue->rx_polling;
+		metal_mutex_release(&queue->rx_lock);
+		/* The messages of a polled queue pair are left to the poller */
+		if (!polling)
+			rpmsg_virtio_rx_notified(rvdev, queue);
+	}
+
+	if (wake && rvdev->tx_wake_cb)
+		rvdev->tx_wake_cb(rdev);
+}
+
+int rpmsg_virtio_get_notify_stats(struct rpmsg_device *rdev,
+				  struct rpmsg_virtio_notify_stats *stats)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
+	unsigned int i;
+
+	if (!rdev || !stats)
+		return RPMSG_ERR_PARAM;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		metal_mutex_acquire(&queue->rx_lock);
+		stats->rx_received += queue->rvq->vq_notify_received;
+		stats->sent += queue->rvq->vq_notify_sent;
+		stats->suppressed += queue->rvq->vq_notify_suppressed;
+		metal_mutex_release(&queue->rx_lock);
+
+		metal_mutex_acquire(&queue->tx_lock);
+		stats->tx_done_received += queue->svq->vq_notify_received;
+		stats->sent += queue->svq->vq_notify_sent;
+		stats->suppressed += queue->svq->vq_notify_suppressed;
+		metal_mutex_release(&queue->tx_lock);
+	}
+
+	return RPMSG_SUCCESS;
+}
+
+int rpmsg_virtio_get_cache_stats(struct rpmsg_device *rdev,
+				 struct rpmsg_virtio_cache_stats *stats)
+{
+	struct rpmsg_virtio_device *rvdev;
+	struct rpmsg_virtio_queue *queue;
+	unsigned int i;
+
+	if (!rdev || !stats)
+		return RPMSG_ERR_PARAM;
+
+	rvdev = metal_container_of(rdev, struct rpmsg_virtio_device, rdev);
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < rvdev->num_queues; i++) {
+		queue = &rvdev->queues[i];
+		metal_mutex_acquire(&queue->rx_lock);
+		stats->invalidated += queue->rx_invalidated;
+		metal_mutex_release(&queue->rx_lock);
+
+		metal_mutex_acquire(&queue->tx_lock);
+		stats->flushed += queue->tx_flushed;
+		metal_mutex_release(&queue->tx_lock);
+	}
+
+	return RPMSG_SUCCESS;
+}
+
+int rpmsg_virtio_set_ept_queue(struct rpmsg_endpoint *ept, unsigned int qid)
+{
+	struct rpmsg_virtio_device *rvdev;
+
+	if (!ept || !ept->rdev)
+		return RPMSG_ERR_PARAM;
+
+	rvdev = metal_container_of(ept->rdev, struct rpmsg_virtio_device, rdev);
+	if (qid != RPMSG_QUEUE_ANY && qid >= rvdev->num_queues)
+		return RPMSG_ERR_PARAM;
+
+	metal_mutex_acquire(&ept->rdev->lock);
+	ept->queue = qid;
+	metal_mutex_release(&ept->rdev->lock);
+
+	return RPMSG_SUCCESS;
+}
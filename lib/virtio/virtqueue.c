@@ -15,14 +15,84 @@
 /* Prototype for internal functions. */
 static void vq_ring_init(struct virtqueue *, void *, int);
 static void vq_ring_update_avail(struct virtqueue *, uint16_t);
+static void vq_ring_publish_avail(struct virtqueue *, uint16_t);
 static uint16_t vq_ring_add_buffer(struct virtqueue *, struct vring_desc *,
 				   uint16_t, struct virtqueue_buf *, int, int);
+static uint16_t vq_ring_add_indirect(struct virtqueue *, uint16_t,
+				     struct virtqueue_buf *, int, int);
 static int vq_ring_enable_interrupt(struct virtqueue *, uint16_t);
 static void vq_ring_free_chain(struct virtqueue *, uint16_t);
 static int vq_ring_must_notify(struct virtqueue *vq);
 static void vq_ring_notify(struct virtqueue *vq);
-static int virtqueue_nused(struct virtqueue *vq);
-static int virtqueue_navail(struct virtqueue *vq);
+static int virtqueue_nused(struct virtqueue *vq, uint16_t min);
+static int virtqueue_navail(struct virtqueue *vq, uint16_t min);
+static uint16_t vq_ring_remote_idx(struct virtqueue *vq, uint16_t local,
+				   uint16_t min);
+static uint32_t vq_ring_in_order_len(struct virtqueue *vq, uint16_t used_idx,
+				     uint16_t desc_idx, bool last);
+static int vq_ring_add_consumed_in_order(struct virtqueue *vq,
+					 uint16_t *head_idxs, uint32_t *lens,
+					 int num);
+
+#if defined(VIRTIO_USE_DCACHE)
+static void vq_ring_dirty(struct vq_dirty_range *range, void *addr,
+			  size_t len);
+static void vq_ring_flush_dirty(struct vq_dirty_range *range);
+#define VRING_DIRTY(r, x, s)		vq_ring_dirty(r, x, s)
+#define VRING_FLUSH_DIRTY(r)		vq_ring_flush_dirty(r)
+#else
+#define VRING_DIRTY(r, x, s)		do { } while (0)
+#define VRING_FLUSH_DIRTY(r)		do { } while (0)
+#endif
+
+/* Prototype for packed ring internal functions. */
+static void vq_packed_init(struct virtqueue *, void *, int);
+static int vq_packed_add_buffer(struct virtqueue *, struct virtqueue_buf *,
+				int, int, void *);
+static metal_phys_addr_t vq_packed_add_indirect(struct virtqueue *, uint16_t,
+						struct virtqueue_buf *, int,
+						int);
+static void *vq_packed_get_buffer(struct virtqueue *, uint32_t *, uint16_t *);
+static void *vq_packed_get_avail_buffer(struct virtqueue *, uint16_t *,
+					uint32_t *);
+static int vq_packed_get_avail_buffer_list(struct virtqueue *, uint16_t *,
+					   struct virtqueue_buf *, int, int *);
+static int vq_packed_add_buffer_batch(struct virtqueue *,
+				      struct virtqueue_buf *, int, int,
+				      void **);
+static int vq_packed_add_consumed_buffer_batch(struct virtqueue *,
+					       uint16_t *, uint32_t *, int);
+static uint32_t vq_packed_get_desc_size(struct virtqueue *);
+static void vq_packed_disable_interrupt(struct virtqueue *);
+static int vq_packed_enable_interrupt(struct virtqueue *, uint16_t);
+static int vq_packed_must_notify(struct virtqueue *);
+static void vq_packed_dump(struct virtqueue *);
+
+static inline bool vq_ring_is_packed(struct virtqueue *vq)
+{
+	return (vq->vq_dev->features & VIRTIO_F_RING_PACKED) != 0;
+}
+
+/* Whether buffers are used in the order they were made available */
+static inline bool vq_ring_in_order(struct virtqueue *vq)
+{
+	return (vq->vq_dev->features & VIRTIO_F_IN_ORDER) &&
+	       !vq_ring_is_packed(vq);
+}
+
+/* Whether a list of needed buffers goes through an indirect table */
+static inline bool vq_use_indirect(struct virtqueue *vq, int needed)
+{
+	return vq->vq_indirect && needed > 1 && needed <= vq->vq_max_indirect &&
+	       (vq->vq_dev->features & VIRTIO_RING_F_INDIRECT_DESC);
+}
+
+/* Indirect table of a buffer ID */
+static inline struct vring_desc *vq_indirect_table(struct virtqueue *vq,
+						   uint16_t id)
+{
+	return &vq->vq_indirect[id * vq->vq_max_indirect];
+}
 
 /* Default implementation of P2V based on libmetal */
 static inline void *virtqueue_phys_to_virt(struct virtqueue *vq,
@@ -64,9 +134,24 @@ int virtqueue_create(struct virtio_device *virt_dev, unsigned short id,
 		vq->vq_free_cnt = vq->vq_nentries;
 		vq->callback = callback;
 		vq->notify = notify;
+		vq->vq_fixed = false;
+		vq->vq_notify_thresh = 0;
+		vq->vq_notify_sent = 0;
+		vq->vq_notify_suppressed = 0;
+		vq->vq_notify_received = 0;
+#if defined(VIRTIO_USE_DCACHE)
+		vq->vq_dirty_desc.start = 0;
+		vq->vq_dirty_desc.end = 0;
+		vq->vq_dirty_ring.start = 0;
+		vq->vq_dirty_ring.end = 0;
+		vq->vq_remote_idx = 0;
+#endif
 
 		/* Initialize vring control block in virtqueue. */
-		vq_ring_init(vq, ring->vaddr, ring->align);
+		if (vq_ring_is_packed(vq))
+			vq_packed_init(vq, ring->vaddr, ring->align);
+		else
+			vq_ring_init(vq, ring->vaddr, ring->align);
 	}
 
 	/*
@@ -77,6 +162,30 @@ int virtqueue_create(struct virtio_device *virt_dev, unsigned short id,
 	return status;
 }
 
+int virtqueue_set_indirect_mem(struct virtqueue *vq, void *mem,
+			       uint16_t max_indirect)
+{
+	unsigned int i, num;
+
+	if (!vq || (mem && max_indirect < 2))
+		return ERROR_VQUEUE_INVLD_PARAM;
+	if (vq->vq_free_cnt != vq->vq_nentries)
+		return ERROR_VRING_FULL;
+
+	vq->vq_indirect = mem;
+	vq->vq_max_indirect = mem ? max_indirect : 0;
+
+	/*
+	 * Split ring tables are chained once and for all, the next fields are
+	 * never modified when buffers are added.
+	 */
+	num = vq->vq_nentries * vq->vq_max_indirect;
+	for (i = 0; i < num; i++)
+		vq->vq_indirect[i].next = (i % vq->vq_max_indirect) + 1;
+
+	return VQUEUE_SUCCESS;
+}
+
 int virtqueue_add_buffer(struct virtqueue *vq, struct virtqueue_buf *buf_list,
 			 int readable, int writable, void *cookie)
 {
@@ -90,11 +199,15 @@ int virtqueue_add_buffer(struct virtqueue *vq, struct virtqueue_buf *buf_list,
 
 	VQ_PARAM_CHK(vq == NULL, status, ERROR_VQUEUE_INVLD_PARAM);
 	VQ_PARAM_CHK(needed < 1, status, ERROR_VQUEUE_INVLD_PARAM);
-	VQ_PARAM_CHK(vq->vq_free_cnt < needed, status, ERROR_VRING_FULL);
+	VQ_PARAM_CHK(vq->vq_free_cnt < (vq_use_indirect(vq, needed) ? 1 : needed),
+		     status, ERROR_VRING_FULL);
 
 	VQUEUE_BUSY(vq);
 
-	if (status == VQUEUE_SUCCESS) {
+	if (status == VQUEUE_SUCCESS && vq_ring_is_packed(vq)) {
+		status = vq_packed_add_buffer(vq, buf_list, readable, writable,
+					      cookie);
+	} else if (status == VQUEUE_SUCCESS) {
 		VQASSERT(vq, cookie != NULL, "enqueuing with no cookie");
 
 		head_idx = vq->vq_desc_head_idx;
@@ -105,14 +218,20 @@ int virtqueue_add_buffer(struct virtqueue *vq, struct virtqueue_buf *buf_list,
 			 "cookie already exists for index");
 
 		dxp->cookie = cookie;
-		dxp->ndescs = needed;
 
 		/* Enqueue buffer onto the ring. */
-		idx = vq_ring_add_buffer(vq, vq->vq_ring.desc, head_idx,
-					 buf_list, readable, writable);
+		if (vq_use_indirect(vq, needed)) {
+			dxp->ndescs = 1;
+			idx = vq_ring_add_indirect(vq, head_idx, buf_list,
+						   readable, writable);
+		} else {
+			dxp->ndescs = needed;
+			idx = vq_ring_add_buffer(vq, vq->vq_ring.desc, head_idx,
+						 buf_list, readable, writable);
+		}
 
 		vq->vq_desc_head_idx = idx;
-		vq->vq_free_cnt -= needed;
+		vq->vq_free_cnt -= dxp->ndescs;
 
 		if (vq->vq_free_cnt == 0) {
 			VQ_RING_ASSERT_CHAIN_TERM(vq);
@@ -132,16 +251,138 @@ int virtqueue_add_buffer(struct virtqueue *vq, struct virtqueue_buf *buf_list,
 	return status;
 }
 
+int virtqueue_add_buffer_batch(struct virtqueue *vq,
+			       struct virtqueue_buf *buf_list, int num,
+			       int writable, void **cookies)
+{
+	struct vq_desc_extra *dxp;
+	int status = VQUEUE_SUCCESS;
+	uint16_t head_idx, avail_idx;
+	int i;
+
+	VQ_PARAM_CHK(vq == NULL, status, ERROR_VQUEUE_INVLD_PARAM);
+	VQ_PARAM_CHK(num < 1, status, ERROR_VQUEUE_INVLD_PARAM);
+	VQ_PARAM_CHK(vq->vq_free_cnt < num, status, ERROR_VRING_FULL);
+
+	VQUEUE_BUSY(vq);
+
+	if (status == VQUEUE_SUCCESS && vq_ring_is_packed(vq)) {
+		status = vq_packed_add_buffer_batch(vq, buf_list, num, writable,
+						    cookies);
+	} else if (status == VQUEUE_SUCCESS) {
+		for (i = 0; i < num; i++) {
+			VQASSERT(vq, cookies[i] != NULL,
+				 "enqueuing with no cookie");
+
+			head_idx = vq->vq_desc_head_idx;
+			VQ_RING_ASSERT_VALID_IDX(vq, head_idx);
+			dxp = &vq->vq_descx[head_idx];
+
+			VQASSERT(vq, dxp->cookie == NULL,
+				 "cookie already exists for index");
+
+			dxp->cookie = cookies[i];
+			dxp->ndescs = 1;
+
+			vq->vq_desc_head_idx =
+				vq_ring_add_buffer(vq, vq->vq_ring.desc, head_idx,
+						   &buf_list[i], !writable,
+						   !!writable);
+			vq->vq_free_cnt--;
+
+			/*
+			 * Fill the avail slots ahead of avail.idx, they are only
+			 * published once the whole batch is in place.
+			 *
+			 * CACHE: avail is never written by remote, so it is safe
+			 * to not invalidate here
+			 */
+			avail_idx = (vq->vq_ring.avail->idx + i) &
+				    (vq->vq_nentries - 1);
+			vq->vq_ring.avail->ring[avail_idx] = head_idx;
+			VRING_DIRTY(&vq->vq_dirty_ring,
+				    &vq->vq_ring.avail->ring[avail_idx],
+				    sizeof(vq->vq_ring.avail->ring[avail_idx]));
+		}
+
+		vq_ring_publish_avail(vq, num);
+	}
+
+	VQUEUE_IDLE(vq);
+
+	return status;
+}
+
+int virtqueue_set_fixed_buffers(struct virtqueue *vq, bool fixed)
+{
+	if (!vq || vq_ring_is_packed(vq) || !VIRTIO_ROLE_IS_DRIVER(vq->vq_dev))
+		return ERROR_VQUEUE_INVLD_PARAM;
+
+	vq->vq_fixed = fixed;
+
+	return VQUEUE_SUCCESS;
+}
+
+int virtqueue_add_fixed_buffer(struct virtqueue *vq, uint16_t head_idx)
+{
+	return virtqueue_add_fixed_buffer_batch(vq, &head_idx, 1);
+}
+
+int virtqueue_add_fixed_buffer_batch(struct virtqueue *vq,
+				     uint16_t *head_idxs, int num)
+{
+	uint16_t avail_idx;
+	int i;
+
+	if (!vq || !vq->vq_fixed || num < 1)
+		return ERROR_VQUEUE_INVLD_PARAM;
+
+	for (i = 0; i < num; i++) {
+		if (head_idxs[i] >= vq->vq_nentries ||
+		    !vq->vq_descx[head_idxs[i]].cookie)
+			return ERROR_VRING_NO_BUFF;
+	}
+
+	VQUEUE_BUSY(vq);
+
+	/*
+	 * The descriptors are left untouched, only the avail slots are
+	 * written.
+	 *
+	 * CACHE: avail is never written by remote, so it is safe to not
+	 * invalidate here
+	 */
+	for (i = 0; i < num; i++) {
+		avail_idx = (vq->vq_ring.avail->idx + i) &
+			    (vq->vq_nentries - 1);
+		vq->vq_ring.avail->ring[avail_idx] = head_idxs[i];
+		VRING_DIRTY(&vq->vq_dirty_ring,
+			    &vq->vq_ring.avail->ring[avail_idx],
+			    sizeof(vq->vq_ring.avail->ring[avail_idx]));
+	}
+
+	vq_ring_publish_avail(vq, num);
+
+	VQUEUE_IDLE(vq);
+
+	return VQUEUE_SUCCESS;
+}
+
 void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx)
 {
 	struct vring_used_elem *uep;
 	void *cookie;
-	uint16_t used_idx, desc_idx;
+	uint16_t used_idx, used_end, desc_idx;
+
+	if (!vq)
+		return NULL;
 
-	/* Used.idx is updated by the virtio device, so we need to invalidate */
-	VRING_INVALIDATE(&vq->vq_ring.used->idx, sizeof(vq->vq_ring.used->idx));
+	if (vq_ring_is_packed(vq))
+		return vq_packed_get_buffer(vq, len, idx);
 
-	if (!vq || vq->vq_used_cons_idx == vq->vq_ring.used->idx)
+	/* Used.idx is updated by the virtio device, read it once exhausted */
+	used_end = vq_ring_remote_idx(vq, vq->vq_used_cons_idx, 1);
+	if (vq->vq_used_cons_idx == used_end)
 		return NULL;
 
 	VQUEUE_BUSY(vq);
@@ -151,18 +392,31 @@ void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx)
 
 	atomic_thread_fence(memory_order_seq_cst);
 
-	/* Used.ring is written by remote, invalidate it */
-	VRING_INVALIDATE(&vq->vq_ring.used->ring[used_idx],
-			 sizeof(vq->vq_ring.used->ring[used_idx]));
-
-	desc_idx = (uint16_t)uep->id;
-	if (len)
-		*len = uep->len;
+	if (vq_ring_in_order(vq)) {
+		/* The used buffer is the one made available in the same slot */
+		desc_idx = vq->vq_ring.avail->ring[used_idx];
+		if (len)
+			*len = vq_ring_in_order_len(vq, used_idx, desc_idx,
+						    vq->vq_used_cons_idx ==
+						    used_end);
+	} else {
+		/* Used.ring is written by remote, invalidate it */
+		VRING_INVALIDATE(&vq->vq_ring.used->ring[used_idx],
+				 sizeof(vq->vq_ring.used->ring[used_idx]));
 
-	vq_ring_free_chain(vq, desc_idx);
+		desc_idx = (uint16_t)uep->id;
+		if (len)
+			*len = uep->len;
+	}
 
 	cookie = vq->vq_descx[desc_idx].cookie;
-	vq->vq_descx[desc_idx].cookie = NULL;
+	if (vq->vq_fixed) {
+		/* The chain stays bound to its buffer */
+		used_idx = desc_idx;
+	} else {
+		vq_ring_free_chain(vq, desc_idx);
+		vq->vq_descx[desc_idx].cookie = NULL;
+	}
 
 	if (idx)
 		*idx = used_idx;
@@ -171,8 +425,100 @@ void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx)
 	return cookie;
 }
 
+int virtqueue_get_buffer_batch(struct virtqueue *vq, void **cookies,
+			       uint32_t *lens, uint16_t *idxs, int num)
+{
+	struct vring_used_elem *uep;
+	uint16_t used_idx, used_end, desc_idx;
+	int i, nused;
+
+	if (!vq || num < 1)
+		return 0;
+
+	/*
+	 * Packed descriptors carry their own used flag, each of them has to be
+	 * checked before its content can be read.
+	 */
+	if (vq_ring_is_packed(vq)) {
+		for (i = 0; i < num; i++) {
+			cookies[i] = vq_packed_get_buffer(vq,
+							  lens ? &lens[i] : NULL,
+							  idxs ? &idxs[i] : NULL);
+			if (!cookies[i])
+				break;
+		}
+		return i;
+	}
+
+	/* Used.idx is read once for the whole batch */
+	nused = virtqueue_nused(vq, num);
+	used_end = vq->vq_used_cons_idx + nused;
+	if (nused > num)
+		nused = num;
+	if (!nused)
+		return 0;
+
+	VQUEUE_BUSY(vq);
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/*
+	 * Used.ring is written by remote, invalidate the slots of the batch
+	 * at once, in two parts if they wrap around the ring. In order, the
+	 * buffers are found from the available ring instead.
+	 */
+	used_idx = vq->vq_used_cons_idx & (vq->vq_nentries - 1);
+	i = metal_min(nused, vq->vq_nentries - used_idx);
+	if (!vq_ring_in_order(vq)) {
+		VRING_INVALIDATE(&vq->vq_ring.used->ring[used_idx],
+				 i * sizeof(struct vring_used_elem));
+		if (i < nused)
+			VRING_INVALIDATE(&vq->vq_ring.used->ring[0],
+					 (nused - i) *
+					 sizeof(struct vring_used_elem));
+	}
+
+	for (i = 0; i < nused; i++) {
+		used_idx = vq->vq_used_cons_idx++ & (vq->vq_nentries - 1);
+		uep = &vq->vq_ring.used->ring[used_idx];
+
+		if (vq_ring_in_order(vq)) {
+			desc_idx = vq->vq_ring.avail->ring[used_idx];
+			if (lens)
+				lens[i] = vq_ring_in_order_len(vq, used_idx,
+							       desc_idx,
+							       vq->vq_used_cons_idx ==
+							       used_end);
+		} else {
+			desc_idx = (uint16_t)uep->id;
+			if (lens)
+				lens[i] = uep->len;
+		}
+
+		cookies[i] = vq->vq_descx[desc_idx].cookie;
+		if (vq->vq_fixed) {
+			/* The chain stays bound to its buffer */
+			used_idx = desc_idx;
+		} else {
+			vq_ring_free_chain(vq, desc_idx);
+			vq->vq_descx[desc_idx].cookie = NULL;
+		}
+
+		if (idxs)
+			idxs[i] = used_idx;
+	}
+
+	VQUEUE_IDLE(vq);
+
+	return nused;
+}
+
 uint32_t virtqueue_get_buffer_length(struct virtqueue *vq, uint16_t idx)
 {
+	/* Packed descriptor slots are recycled, the length is kept per buffer ID */
+	if (vq_ring_is_packed(vq))
+		return vq->vq_descx[idx].len;
+
 	/* Invalidate the desc entry written by driver before accessing it */
 	VRING_INVALIDATE(&vq->vq_ring.desc[idx].len,
 			 sizeof(vq->vq_ring.desc[idx].len));
@@ -181,6 +527,9 @@ uint32_t virtqueue_get_buffer_length(struct virtqueue *vq, uint16_t idx)
 
 void *virtqueue_get_buffer_addr(struct virtqueue *vq, uint16_t idx)
 {
+	if (vq_ring_is_packed(vq))
+		return vq->vq_descx[idx].cookie;
+
 	/* Invalidate the desc entry written by driver before accessing it */
 	VRING_INVALIDATE(&vq->vq_ring.desc[idx].addr,
 			 sizeof(vq->vq_ring.desc[idx].addr));
@@ -206,11 +555,14 @@ void *virtqueue_get_first_avail_buffer(struct virtqueue *vq, uint16_t *avail_idx
 	uint16_t head_idx = 0;
 	void *buffer;
 
+	if (vq_ring_is_packed(vq))
+		return vq_packed_get_avail_buffer(vq, avail_idx, len);
+
 	atomic_thread_fence(memory_order_seq_cst);
 
-	/* Avail.idx is updated by driver, invalidate it */
-	VRING_INVALIDATE(&vq->vq_ring.avail->idx, sizeof(vq->vq_ring.avail->idx));
-	if (vq->vq_available_idx == vq->vq_ring.avail->idx) {
+	/* Avail.idx is updated by driver, read it once exhausted */
+	if (vq->vq_available_idx ==
+	    vq_ring_remote_idx(vq, vq->vq_available_idx, 1)) {
 		return NULL;
 	}
 
@@ -231,13 +583,86 @@ void *virtqueue_get_first_avail_buffer(struct virtqueue *vq, uint16_t *avail_idx
 	return buffer;
 }
 
+int virtqueue_get_avail_buffer_list(struct virtqueue *vq, uint16_t *avail_idx,
+				    struct virtqueue_buf *buf_list, int max,
+				    int *readable)
+{
+	struct vring_desc *desc, *dp;
+	uint16_t head_idx, idx, next;
+	unsigned int num;
+	int count = 0, nread = 0;
+
+	if (!vq || !avail_idx || !buf_list || max < 1)
+		return ERROR_VQUEUE_INVLD_PARAM;
+
+	if (vq_ring_is_packed(vq))
+		return vq_packed_get_avail_buffer_list(vq, avail_idx, buf_list,
+						       max, readable);
+
+	/* Avail.idx is updated by driver, read it once exhausted */
+	if (vq->vq_available_idx ==
+	    vq_ring_remote_idx(vq, vq->vq_available_idx, 1))
+		return 0;
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/* Avail.ring is updated by driver, invalidate it */
+	head_idx = vq->vq_available_idx & (vq->vq_nentries - 1);
+	VRING_INVALIDATE(&vq->vq_ring.avail->ring[head_idx],
+			 sizeof(vq->vq_ring.avail->ring[head_idx]));
+	idx = vq->vq_ring.avail->ring[head_idx];
+	if (idx >= vq->vq_nentries)
+		return ERROR_INVLD_DESC_IDX;
+
+	/* The desc entries are written by driver, invalidate them */
+	desc = vq->vq_ring.desc;
+	num = vq->vq_nentries;
+	next = idx;
+	VRING_INVALIDATE(&desc[idx], sizeof(desc[idx]));
+	if (desc[idx].flags & VRING_DESC_F_INDIRECT) {
+		num = desc[idx].len / sizeof(struct vring_desc);
+		desc = virtqueue_phys_to_virt(vq, desc[idx].addr);
+		if (!desc || !num)
+			return ERROR_INVLD_DESC_IDX;
+		VRING_INVALIDATE(desc, num * sizeof(struct vring_desc));
+		next = 0;
+	}
+
+	while (1) {
+		if (next >= num)
+			return ERROR_INVLD_DESC_IDX;
+		if (count == max)
+			return ERROR_VRING_MAX_DESC;
+
+		dp = &desc[next];
+		VRING_INVALIDATE(dp, sizeof(*dp));
+		buf_list[count].buf = virtqueue_phys_to_virt(vq, dp->addr);
+		buf_list[count].len = dp->len;
+		if (!(dp->flags & VRING_DESC_F_WRITE))
+			nread++;
+		count++;
+
+		if (!(dp->flags & VRING_DESC_F_NEXT))
+			break;
+		next = dp->next;
+	}
+
+	vq->vq_available_idx++;
+	*avail_idx = idx;
+	if (readable)
+		*readable = nread;
+
+	return count;
+}
+
 void *virtqueue_get_next_avail_buffer(struct virtqueue *vq, uint16_t idx,
 				      uint16_t *next_idx, uint32_t *next_len)
 {
 	void *buffer;
 	uint16_t next;
 
-	if (!next_idx)
+	/* Chained buffers are not exposed descriptor by descriptor in packed rings */
+	if (!next_idx || vq_ring_is_packed(vq))
 		return NULL;
 
 	VRING_INVALIDATE(&vq->vq_ring.desc[idx], sizeof(struct vring_desc));
@@ -257,35 +682,56 @@ void *virtqueue_get_next_avail_buffer(struct virtqueue *vq, uint16_t idx,
 
 int virtqueue_add_consumed_buffer(struct virtqueue *vq, uint16_t head_idx,
 				  uint32_t len)
+{
+	return virtqueue_add_consumed_buffer_batch(vq, &head_idx, &len, 1);
+}
+
+int virtqueue_add_consumed_buffer_batch(struct virtqueue *vq,
+					uint16_t *head_idxs, uint32_t *lens,
+					int num)
 {
 	struct vring_used_elem *used_desc = NULL;
 	uint16_t used_idx;
+	int i;
 
-	if (head_idx >= vq->vq_nentries) {
-		return ERROR_VRING_NO_BUFF;
+	for (i = 0; i < num; i++) {
+		if (head_idxs[i] >= vq->vq_nentries)
+			return ERROR_VRING_NO_BUFF;
 	}
 
-	VQUEUE_BUSY(vq);
+	if (vq_ring_is_packed(vq))
+		return vq_packed_add_consumed_buffer_batch(vq, head_idxs, lens,
+							   num);
 
-	/* CACHE: used is never written by driver, so it's safe to directly access it */
-	used_idx = vq->vq_ring.used->idx & (vq->vq_nentries - 1);
-	used_desc = &vq->vq_ring.used->ring[used_idx];
-	used_desc->id = head_idx;
-	used_desc->len = len;
+	if (vq_ring_in_order(vq))
+		return vq_ring_add_consumed_in_order(vq, head_idxs, lens, num);
+
+	VQUEUE_BUSY(vq);
 
-	/* We still need to flush it because this is read by driver */
-	VRING_FLUSH(&vq->vq_ring.used->ring[used_idx],
-		    sizeof(vq->vq_ring.used->ring[used_idx]));
+	for (i = 0; i < num; i++) {
+		/* CACHE: used is never written by driver, so it's safe to directly access it */
+		used_idx = (vq->vq_ring.used->idx + i) & (vq->vq_nentries - 1);
+		used_desc = &vq->vq_ring.used->ring[used_idx];
+		used_desc->id = head_idxs[i];
+		used_desc->len = lens[i];
+
+		/* We still need to flush it because this is read by driver */
+		VRING_DIRTY(&vq->vq_dirty_ring,
+			    &vq->vq_ring.used->ring[used_idx],
+			    sizeof(vq->vq_ring.used->ring[used_idx]));
+	}
 
+	/* All the slots reach the memory before the index covers them */
+	VRING_FLUSH_DIRTY(&vq->vq_dirty_ring);
 	atomic_thread_fence(memory_order_seq_cst);
 
-	vq->vq_ring.used->idx++;
+	vq->vq_ring.used->idx += num;
 
 	/* Used.idx is read by driver, so we need to flush it */
 	VRING_FLUSH(&vq->vq_ring.used->idx, sizeof(vq->vq_ring.used->idx));
 
 	/* Keep pending count until virtqueue_notify(). */
-	vq->vq_queued_cnt++;
+	vq->vq_queued_cnt += num;
 
 	VQUEUE_IDLE(vq);
 
@@ -294,14 +740,28 @@ int virtqueue_add_consumed_buffer(struct virtqueue *vq, uint16_t head_idx,
 
 int virtqueue_enable_cb(struct virtqueue *vq)
 {
-	return vq_ring_enable_interrupt(vq, 0);
+	uint16_t ndesc = vq->vq_notify_thresh ? vq->vq_notify_thresh - 1 : 0;
+
+	return vq_ring_enable_interrupt(vq, ndesc);
+}
+
+int virtqueue_set_notify_threshold(struct virtqueue *vq, uint16_t thresh)
+{
+	if (!vq || thresh > vq->vq_nentries)
+		return ERROR_VQUEUE_INVLD_PARAM;
+
+	vq->vq_notify_thresh = thresh;
+
+	return VQUEUE_SUCCESS;
 }
 
 void virtqueue_disable_cb(struct virtqueue *vq)
 {
 	VQUEUE_BUSY(vq);
 
-	if (vq->vq_dev->features & VIRTIO_RING_F_EVENT_IDX) {
+	if (vq_ring_is_packed(vq)) {
+		vq_packed_disable_interrupt(vq);
+	} else if (vq->vq_dev->features & VIRTIO_RING_F_EVENT_IDX) {
 		if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev)) {
 			vring_used_event(&vq->vq_ring) =
 			    vq->vq_used_cons_idx - vq->vq_nentries - 1;
@@ -337,8 +797,12 @@ void virtqueue_kick(struct virtqueue *vq)
 	/* Ensure updated avail->idx is visible to host. */
 	atomic_thread_fence(memory_order_seq_cst);
 
-	if (vq_ring_must_notify(vq))
+	if (vq_ring_must_notify(vq)) {
 		vq_ring_notify(vq);
+		vq->vq_notify_sent++;
+	} else if (vq->vq_queued_cnt) {
+		vq->vq_notify_suppressed++;
+	}
 
 	vq->vq_queued_cnt = 0;
 
@@ -350,6 +814,11 @@ void virtqueue_dump(struct virtqueue *vq)
 	if (!vq)
 		return;
 
+	if (vq_ring_is_packed(vq)) {
+		vq_packed_dump(vq);
+		return;
+	}
+
 	VRING_INVALIDATE(&vq->vq_ring.avail, sizeof(vq->vq_ring.avail));
 	VRING_INVALIDATE(&vq->vq_ring.used, sizeof(vq->vq_ring.used));
 
@@ -370,6 +839,9 @@ uint32_t virtqueue_get_desc_size(struct virtqueue *vq)
 	uint16_t avail_idx = 0;
 	uint32_t len = 0;
 
+	if (vq_ring_is_packed(vq))
+		return vq_packed_get_desc_size(vq);
+
 	/* Avail.idx is updated by driver, invalidate it */
 	VRING_INVALIDATE(&vq->vq_ring.avail->idx, sizeof(vq->vq_ring.avail->idx));
 
@@ -441,15 +913,37 @@ static uint16_t vq_ring_add_buffer(struct virtqueue *vq,
 
 		/*
 		 * Instead of flushing the whole desc region, we flush only the
-		 * single entry hopefully saving some cycles
+		 * entries written, merged until the buffers are published
 		 */
-		VRING_FLUSH(&desc[idx], sizeof(desc[idx]));
-
+		VRING_DIRTY(&vq->vq_dirty_desc, &desc[idx], sizeof(desc[idx]));
 	}
 
 	return idx;
 }
 
+/*
+ *
+ * vq_ring_add_indirect
+ *
+ */
+static uint16_t vq_ring_add_indirect(struct virtqueue *vq, uint16_t head_idx,
+				     struct virtqueue_buf *buf_list,
+				     int readable, int writable)
+{
+	struct vring_desc *table = vq_indirect_table(vq, head_idx);
+	struct vring_desc *dp = &vq->vq_ring.desc[head_idx];
+
+	/* Fill the indirect table, then point the single ring entry to it */
+	vq_ring_add_buffer(vq, table, 0, buf_list, readable, writable);
+
+	dp->addr = virtqueue_virt_to_phys(vq, table);
+	dp->len = (readable + writable) * sizeof(struct vring_desc);
+	dp->flags = VRING_DESC_F_INDIRECT;
+	VRING_DIRTY(&vq->vq_dirty_desc, dp, sizeof(*dp));
+
+	return dp->next;
+}
+
 /*
  *
  * vq_ring_free_chain
@@ -540,18 +1034,31 @@ static void vq_ring_update_avail(struct virtqueue *vq, uint16_t desc_idx)
 	vq->vq_ring.avail->ring[avail_idx] = desc_idx;
 
 	/* We still need to flush the ring */
-	VRING_FLUSH(&vq->vq_ring.avail->ring[avail_idx],
+	VRING_DIRTY(&vq->vq_dirty_ring, &vq->vq_ring.avail->ring[avail_idx],
 		    sizeof(vq->vq_ring.avail->ring[avail_idx]));
 
+	vq_ring_publish_avail(vq, 1);
+}
+
+/*
+ *
+ * vq_ring_publish_avail
+ *
+ */
+static void vq_ring_publish_avail(struct virtqueue *vq, uint16_t num)
+{
+	/* Make the num filled avail slots visible before the index covers them */
+	VRING_FLUSH_DIRTY(&vq->vq_dirty_desc);
+	VRING_FLUSH_DIRTY(&vq->vq_dirty_ring);
 	atomic_thread_fence(memory_order_seq_cst);
 
-	vq->vq_ring.avail->idx++;
+	vq->vq_ring.avail->idx += num;
 
 	/* And the index */
 	VRING_FLUSH(&vq->vq_ring.avail->idx, sizeof(vq->vq_ring.avail->idx));
 
 	/* Keep pending count until virtqueue_notify(). */
-	vq->vq_queued_cnt++;
+	vq->vq_queued_cnt += num;
 }
 
 /*
@@ -561,6 +1068,9 @@ static void vq_ring_update_avail(struct virtqueue *vq, uint16_t desc_idx)
  */
 static int vq_ring_enable_interrupt(struct virtqueue *vq, uint16_t ndesc)
 {
+	if (vq_ring_is_packed(vq))
+		return vq_packed_enable_interrupt(vq, ndesc);
+
 	/*
 	 * Enable interrupts, making sure we get the latest index of
 	 * what's already been consumed.
@@ -599,12 +1109,12 @@ static int vq_ring_enable_interrupt(struct virtqueue *vq, uint16_t ndesc)
 	 * entries.
 	 */
 	if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev)) {
-		if (virtqueue_nused(vq) > ndesc) {
+		if (virtqueue_nused(vq, ndesc + 1) > ndesc) {
 			return 1;
 		}
 	}
 	if (VIRTIO_ROLE_IS_DEVICE(vq->vq_dev)) {
-		if (virtqueue_navail(vq) > ndesc) {
+		if (virtqueue_navail(vq, ndesc + 1) > ndesc) {
 			return 1;
 		}
 	}
@@ -620,6 +1130,7 @@ static int vq_ring_enable_interrupt(struct virtqueue *vq, uint16_t ndesc)
 void virtqueue_notification(struct virtqueue *vq)
 {
 	atomic_thread_fence(memory_order_seq_cst);
+	vq->vq_notify_received++;
 	if (vq->callback)
 		vq->callback(vq);
 }
@@ -633,6 +1144,9 @@ static int vq_ring_must_notify(struct virtqueue *vq)
 {
 	uint16_t new_idx, prev_idx, event_idx;
 
+	if (vq_ring_is_packed(vq))
+		return vq_packed_must_notify(vq);
+
 	if (vq->vq_dev->features & VIRTIO_RING_F_EVENT_IDX) {
 		if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev)) {
 			/* CACHE: no need to invalidate avail */
@@ -688,13 +1202,12 @@ static void vq_ring_notify(struct virtqueue *vq)
  * virtqueue_nused
  *
  */
-static int virtqueue_nused(struct virtqueue *vq)
+static int virtqueue_nused(struct virtqueue *vq, uint16_t min)
 {
 	uint16_t used_idx, nused;
 
 	/* Used is written by remote */
-	VRING_INVALIDATE(&vq->vq_ring.used->idx, sizeof(vq->vq_ring.used->idx));
-	used_idx = vq->vq_ring.used->idx;
+	used_idx = vq_ring_remote_idx(vq, vq->vq_used_cons_idx, min);
 
 	nused = (uint16_t)(used_idx - vq->vq_used_cons_idx);
 	VQASSERT(vq, nused <= vq->vq_nentries, "used more than available");
@@ -707,17 +1220,807 @@ static int virtqueue_nused(struct virtqueue *vq)
  * virtqueue_navail
  *
  */
-static int virtqueue_navail(struct virtqueue *vq)
+static int virtqueue_navail(struct virtqueue *vq, uint16_t min)
 {
 	uint16_t avail_idx, navail;
 
 	/* Avail is written by driver */
-	VRING_INVALIDATE(&vq->vq_ring.avail->idx, sizeof(vq->vq_ring.avail->idx));
-
-	avail_idx = vq->vq_ring.avail->idx;
+	avail_idx = vq_ring_remote_idx(vq, vq->vq_available_idx, min);
 
 	navail = (uint16_t)(avail_idx - vq->vq_available_idx);
 	VQASSERT(vq, navail <= vq->vq_nentries, "avail more than available");
 
 	return navail;
 }
+
+
+/*
+ *
+ * vq_ring_remote_idx
+ *
+ * Returns the index published by the other side, used.idx on the driver side
+ * and avail.idx on the device side. With VIRTIO_USE_DCACHE, the index is only
+ * invalidated and read again from memory once fewer than min entries are left
+ * after local in the value read last.
+ */
+static uint16_t vq_ring_remote_idx(struct virtqueue *vq, uint16_t local,
+				   uint16_t min)
+{
+	struct vring *vr = &vq->vq_ring;
+
+#if defined(VIRTIO_USE_DCACHE)
+	if ((uint16_t)(vq->vq_remote_idx - local) >= min)
+		return vq->vq_remote_idx;
+#else
+	(void)local;
+	(void)min;
+#endif
+
+	if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev)) {
+		VRING_INVALIDATE(&vr->used->idx, sizeof(vr->used->idx));
+		local = vr->used->idx;
+	} else {
+		VRING_INVALIDATE(&vr->avail->idx, sizeof(vr->avail->idx));
+		local = vr->avail->idx;
+	}
+
+#if defined(VIRTIO_USE_DCACHE)
+	vq->vq_remote_idx = local;
+#endif
+
+	return local;
+}
+
+/*
+ *
+ * vq_ring_in_order_len
+ *
+ * Returns the length of a buffer used in order. The device side only writes
+ * the used ring element of the last buffer of a batch, the used index always
+ * ends a batch. The other buffers report the length of their head descriptor.
+ */
+static uint32_t vq_ring_in_order_len(struct virtqueue *vq, uint16_t used_idx,
+				     uint16_t desc_idx, bool last)
+{
+	if (!last)
+		return vq->vq_ring.desc[desc_idx].len;
+
+	/* Used.ring is written by remote, invalidate it */
+	VRING_INVALIDATE(&vq->vq_ring.used->ring[used_idx],
+			 sizeof(vq->vq_ring.used->ring[used_idx]));
+
+	return vq->vq_ring.used->ring[used_idx].len;
+}
+
+/*
+ *
+ * vq_ring_add_consumed_in_order
+ *
+ * Returns consumed buffers to the driver in the order it made them available.
+ * The buffers are marked consumed, then the longest run of consumed buffers
+ * following the used index is published with a single used ring element, the
+ * one of its last buffer. A buffer still held blocks the ones behind it.
+ */
+static int vq_ring_add_consumed_in_order(struct virtqueue *vq,
+					 uint16_t *head_idxs, uint32_t *lens,
+					 int num)
+{
+	struct vring_used_elem *used_desc;
+	struct vq_desc_extra *dxp;
+	uint16_t used_idx, head_idx = 0;
+	uint16_t count = 0;
+	int i;
+
+	VQUEUE_BUSY(vq);
+
+	for (i = 0; i < num; i++) {
+		dxp = &vq->vq_descx[head_idxs[i]];
+		dxp->ndescs = 1;
+		dxp->len = lens[i];
+	}
+
+	/* CACHE: used is never written by driver, avail was read when consumed */
+	while ((uint16_t)(vq->vq_ring.used->idx + count) !=
+	       vq->vq_available_idx) {
+		used_idx = (vq->vq_ring.used->idx + count) &
+			   (vq->vq_nentries - 1);
+		dxp = &vq->vq_descx[vq->vq_ring.avail->ring[used_idx]];
+		if (!dxp->ndescs)
+			break;
+		dxp->ndescs = 0;
+		head_idx = vq->vq_ring.avail->ring[used_idx];
+		count++;
+	}
+
+	if (!count) {
+		VQUEUE_IDLE(vq);
+		return VQUEUE_SUCCESS;
+	}
+
+	used_idx = (vq->vq_ring.used->idx + count - 1) & (vq->vq_nentries - 1);
+	used_desc = &vq->vq_ring.used->ring[used_idx];
+	used_desc->id = head_idx;
+	used_desc->len = vq->vq_descx[head_idx].len;
+
+	/* The slot reaches the memory before the index covers it */
+	VRING_FLUSH(used_desc, sizeof(*used_desc));
+	atomic_thread_fence(memory_order_seq_cst);
+
+	vq->vq_ring.used->idx += count;
+
+	/* Used.idx is read by driver, so we need to flush it */
+	VRING_FLUSH(&vq->vq_ring.used->idx, sizeof(vq->vq_ring.used->idx));
+
+	/* Keep pending count until virtqueue_notify(). */
+	vq->vq_queued_cnt += count;
+
+	VQUEUE_IDLE(vq);
+
+	return VQUEUE_SUCCESS;
+}
+
+#if defined(VIRTIO_USE_DCACHE)
+/*
+ *
+ * vq_ring_dirty
+ *
+ * Records a written vring range, to be flushed with the others at once.
+ * Ranges less than a cache line apart are merged, a range further away first
+ * flushes the pending one.
+ */
+static void vq_ring_dirty(struct vq_dirty_range *range, void *addr, size_t len)
+{
+	uintptr_t start = (uintptr_t)addr;
+	uintptr_t end = start + len;
+
+	if (range->start != range->end &&
+	    (start > range->end + VIRTIO_CACHE_LINE_SIZE ||
+	     end + VIRTIO_CACHE_LINE_SIZE < range->start))
+		vq_ring_flush_dirty(range);
+
+	if (range->start == range->end) {
+		range->start = start;
+		range->end = end;
+	} else {
+		range->start = metal_min(range->start, start);
+		range->end = metal_max(range->end, end);
+	}
+}
+
+/*
+ *
+ * vq_ring_flush_dirty
+ *
+ */
+static void vq_ring_flush_dirty(struct vq_dirty_range *range)
+{
+	if (range->start == range->end)
+		return;
+
+	metal_cache_flush((void *)range->start, range->end - range->start);
+	range->start = 0;
+	range->end = 0;
+}
+#endif /* VIRTIO_USE_DCACHE */
+
+/**************************************************************************
+ *                          Packed Ring Functions                         *
+ **************************************************************************/
+
+/* Avail/used flag bits of a descriptor made available with wrap counter */
+static inline uint16_t vq_packed_avail_flags(bool wrap)
+{
+	return wrap ? VRING_PACKED_DESC_F_AVAIL : VRING_PACKED_DESC_F_USED;
+}
+
+/* Avail/used flag bits of a descriptor marked used with wrap counter */
+static inline uint16_t vq_packed_used_flags(bool wrap)
+{
+	return wrap ? VRING_PACKED_DESC_F_AVAIL | VRING_PACKED_DESC_F_USED : 0;
+}
+
+static inline bool vq_packed_desc_is_avail(uint16_t flags, bool wrap)
+{
+	bool avail = !!(flags & VRING_PACKED_DESC_F_AVAIL);
+	bool used = !!(flags & VRING_PACKED_DESC_F_USED);
+
+	return avail == wrap && used != wrap;
+}
+
+static inline bool vq_packed_desc_is_used(uint16_t flags, bool wrap)
+{
+	bool avail = !!(flags & VRING_PACKED_DESC_F_AVAIL);
+	bool used = !!(flags & VRING_PACKED_DESC_F_USED);
+
+	return avail == used && used == wrap;
+}
+
+/*
+ * Advance a descriptor slot index by n entries, toggling the wrap counter
+ * when the end of the ring is crossed.
+ */
+static inline uint16_t vq_packed_advance(struct virtqueue *vq, uint16_t idx,
+					 uint16_t n, bool *wrap)
+{
+	idx += n;
+	if (idx >= vq->vq_nentries) {
+		idx -= vq->vq_nentries;
+		*wrap = !*wrap;
+	}
+
+	return idx;
+}
+
+/*
+ *
+ * vq_packed_init
+ *
+ */
+static void vq_packed_init(struct virtqueue *vq, void *ring_mem, int alignment)
+{
+	int size = vq->vq_nentries;
+
+	vring_packed_init(&vq->vq_packed_ring, size, ring_mem, alignment);
+	vq->vq_packed_avail_wrap = true;
+	vq->vq_packed_used_wrap = true;
+
+	if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev)) {
+		int i;
+
+		/* Buffer IDs are recycled through a free list in vq_descx */
+		for (i = 0; i < size - 1; i++)
+			vq->vq_descx[i].next = i + 1;
+		vq->vq_descx[i].next = VQ_RING_DESC_CHAIN_END;
+		vq->vq_desc_head_idx = 0;
+	}
+}
+
+/*
+ *
+ * vq_packed_add_buffer
+ *
+ */
+static int vq_packed_add_buffer(struct virtqueue *vq,
+				struct virtqueue_buf *buf_list, int readable,
+				int writable, void *cookie)
+{
+	struct vring_packed_desc *desc = vq->vq_packed_ring.desc;
+	struct vq_desc_extra *dxp;
+	uint16_t head_flags = 0;
+	uint16_t head_idx, idx, id, flags;
+	bool wrap;
+	int i, needed;
+
+	needed = readable + writable;
+
+	id = vq->vq_desc_head_idx;
+	VQ_RING_ASSERT_VALID_IDX(vq, id);
+	dxp = &vq->vq_descx[id];
+
+	VQASSERT(vq, dxp->cookie == NULL, "cookie already exists for index");
+
+	vq->vq_desc_head_idx = dxp->next;
+	dxp->cookie = cookie;
+	dxp->ndescs = needed;
+	dxp->len = buf_list[0].len;
+
+	head_idx = vq->vq_packed_avail_idx;
+	wrap = vq->vq_packed_avail_wrap;
+
+	if (vq_use_indirect(vq, needed)) {
+		/* Make a single descriptor point to the indirect table */
+		desc[head_idx].addr = vq_packed_add_indirect(vq, id, buf_list,
+							     readable, writable);
+		desc[head_idx].len = needed * sizeof(struct vring_packed_desc);
+		desc[head_idx].id = id;
+		head_flags = vq_packed_avail_flags(wrap) | VRING_DESC_F_INDIRECT;
+		dxp->ndescs = 1;
+		needed = 1;
+		idx = vq_packed_advance(vq, head_idx, 1, &wrap);
+	} else {
+		for (i = 0, idx = head_idx; i < needed; i++) {
+			desc[idx].addr = virtqueue_virt_to_phys(vq,
+								buf_list[i].buf);
+			desc[idx].len = buf_list[i].len;
+			desc[idx].id = id;
+
+			flags = vq_packed_avail_flags(wrap);
+			if (i < needed - 1)
+				flags |= VRING_DESC_F_NEXT;
+			if (i >= readable)
+				flags |= VRING_DESC_F_WRITE;
+
+			/*
+			 * The head flags are written last, they make the whole
+			 * chain visible to the device at once.
+			 */
+			if (i == 0) {
+				head_flags = flags;
+			} else {
+				desc[idx].flags = flags;
+				VRING_FLUSH(&desc[idx], sizeof(desc[idx]));
+			}
+
+			idx = vq_packed_advance(vq, idx, 1, &wrap);
+		}
+	}
+
+	vq->vq_packed_avail_idx = idx;
+	vq->vq_packed_avail_wrap = wrap;
+	vq->vq_free_cnt -= needed;
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	desc[head_idx].flags = head_flags;
+	VRING_FLUSH(&desc[head_idx], sizeof(desc[head_idx]));
+
+	/* Packed rings count the slots made available until virtqueue_kick() */
+	vq->vq_queued_cnt += needed;
+
+	return VQUEUE_SUCCESS;
+}
+
+/*
+ *
+ * vq_packed_add_indirect
+ *
+ */
+static metal_phys_addr_t vq_packed_add_indirect(struct virtqueue *vq,
+						uint16_t id,
+						struct virtqueue_buf *buf_list,
+						int readable, int writable)
+{
+	struct vring_packed_desc *table;
+	int i, needed = readable + writable;
+
+	/* Packed indirect tables are plain arrays of packed descriptors */
+	table = (struct vring_packed_desc *)vq_indirect_table(vq, id);
+	for (i = 0; i < needed; i++) {
+		table[i].addr = virtqueue_virt_to_phys(vq, buf_list[i].buf);
+		table[i].len = buf_list[i].len;
+		table[i].id = 0;
+		table[i].flags = i >= readable ? VRING_DESC_F_WRITE : 0;
+	}
+	VRING_FLUSH(table, needed * sizeof(*table));
+
+	return virtqueue_virt_to_phys(vq, table);
+}
+
+/*
+ *
+ * vq_packed_get_buffer
+ *
+ */
+static void *vq_packed_get_buffer(struct virtqueue *vq, uint32_t *len,
+				  uint16_t *idx)
+{
+	struct vring_packed_desc *dp;
+	struct vq_desc_extra *dxp;
+	void *cookie;
+	uint16_t id;
+
+	/* The used descriptor is written by the device, invalidate it */
+	dp = &vq->vq_packed_ring.desc[vq->vq_used_cons_idx];
+	VRING_INVALIDATE(dp, sizeof(*dp));
+	if (!vq_packed_desc_is_used(dp->flags, vq->vq_packed_used_wrap))
+		return NULL;
+
+	VQUEUE_BUSY(vq);
+
+	/* Read the descriptor content only after having checked its flags */
+	atomic_thread_fence(memory_order_seq_cst);
+
+	id = dp->id;
+	VQ_RING_ASSERT_VALID_IDX(vq, id);
+	dxp = &vq->vq_descx[id];
+	if (len)
+		*len = dp->len;
+
+	vq->vq_used_cons_idx = vq_packed_advance(vq, vq->vq_used_cons_idx,
+						 dxp->ndescs,
+						 &vq->vq_packed_used_wrap);
+	vq->vq_free_cnt += dxp->ndescs;
+
+	cookie = dxp->cookie;
+	dxp->cookie = NULL;
+	dxp->next = vq->vq_desc_head_idx;
+	vq->vq_desc_head_idx = id;
+
+	if (idx)
+		*idx = id;
+	VQUEUE_IDLE(vq);
+
+	return cookie;
+}
+
+/*
+ *
+ * vq_packed_get_avail_buffer
+ *
+ */
+static void *vq_packed_get_avail_buffer(struct virtqueue *vq,
+					uint16_t *avail_idx, uint32_t *len)
+{
+	struct vring_packed_desc *desc = vq->vq_packed_ring.desc;
+	struct vq_desc_extra *dxp;
+	uint16_t idx, ndescs = 1;
+	uint16_t head_idx;
+
+	head_idx = vq->vq_available_idx;
+
+	/* The descriptor is written by the driver, invalidate it */
+	VRING_INVALIDATE(&desc[head_idx], sizeof(desc[head_idx]));
+	if (!vq_packed_desc_is_avail(desc[head_idx].flags,
+				     vq->vq_packed_avail_wrap))
+		return NULL;
+
+	VQUEUE_BUSY(vq);
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/* The buffer ID is carried by the last descriptor of the chain */
+	idx = head_idx;
+	while (desc[idx].flags & VRING_DESC_F_NEXT) {
+		idx = (idx + 1) & (vq->vq_nentries - 1);
+		VRING_INVALIDATE(&desc[idx], sizeof(desc[idx]));
+		ndescs++;
+	}
+
+	*avail_idx = desc[idx].id;
+	VQ_RING_ASSERT_VALID_IDX(vq, *avail_idx);
+
+	/*
+	 * Keep the buffer information per buffer ID, the descriptor slot can be
+	 * overwritten by a used descriptor before this buffer is returned.
+	 */
+	dxp = &vq->vq_descx[*avail_idx];
+	dxp->cookie = virtqueue_phys_to_virt(vq, desc[head_idx].addr);
+	dxp->len = desc[head_idx].len;
+	dxp->ndescs = ndescs;
+	*len = dxp->len;
+
+	vq->vq_available_idx = vq_packed_advance(vq, head_idx, ndescs,
+						 &vq->vq_packed_avail_wrap);
+
+	VQUEUE_IDLE(vq);
+
+	return dxp->cookie;
+}
+
+/*
+ *
+ * vq_packed_get_avail_buffer_list
+ *
+ */
+static int vq_packed_get_avail_buffer_list(struct virtqueue *vq,
+					   uint16_t *avail_idx,
+					   struct virtqueue_buf *buf_list,
+					   int max, int *readable)
+{
+	struct vring_packed_desc *desc = vq->vq_packed_ring.desc;
+	struct vring_packed_desc *dp;
+	struct vq_desc_extra *dxp;
+	uint16_t head_idx, idx, ndescs;
+	int count = 0, nread = 0, num = 0;
+
+	head_idx = vq->vq_available_idx;
+
+	/* The descriptor is written by the driver, invalidate it */
+	VRING_INVALIDATE(&desc[head_idx], sizeof(desc[head_idx]));
+	if (!vq_packed_desc_is_avail(desc[head_idx].flags,
+				     vq->vq_packed_avail_wrap))
+		return 0;
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	idx = head_idx;
+	dp = &desc[head_idx];
+	if (dp->flags & VRING_DESC_F_INDIRECT) {
+		num = dp->len / sizeof(*dp);
+		dp = virtqueue_phys_to_virt(vq, dp->addr);
+		if (!dp || !num)
+			return ERROR_INVLD_DESC_IDX;
+		VRING_INVALIDATE(dp, num * sizeof(*dp));
+	}
+
+	while (1) {
+		if (count == max)
+			return ERROR_VRING_MAX_DESC;
+
+		buf_list[count].buf = virtqueue_phys_to_virt(vq, dp->addr);
+		buf_list[count].len = dp->len;
+		if (!(dp->flags & VRING_DESC_F_WRITE))
+			nread++;
+		count++;
+
+		/* Indirect table entries are sequential, with no next flag */
+		if (num) {
+			if (count == num)
+				break;
+			dp++;
+			continue;
+		}
+
+		if (!(dp->flags & VRING_DESC_F_NEXT))
+			break;
+		idx = (idx + 1) & (vq->vq_nentries - 1);
+		dp = &desc[idx];
+		VRING_INVALIDATE(dp, sizeof(*dp));
+	}
+
+	/* The buffer ID is carried by the last ring descriptor of the chain */
+	ndescs = num ? 1 : count;
+	*avail_idx = desc[idx].id;
+	if (*avail_idx >= vq->vq_nentries)
+		return ERROR_INVLD_DESC_IDX;
+
+	dxp = &vq->vq_descx[*avail_idx];
+	dxp->cookie = buf_list[0].buf;
+	dxp->len = buf_list[0].len;
+	dxp->ndescs = ndescs;
+
+	vq->vq_available_idx = vq_packed_advance(vq, head_idx, ndescs,
+						 &vq->vq_packed_avail_wrap);
+	if (readable)
+		*readable = nread;
+
+	return count;
+}
+
+/*
+ *
+ * vq_packed_add_buffer_batch
+ *
+ */
+static int vq_packed_add_buffer_batch(struct virtqueue *vq,
+				      struct virtqueue_buf *buf_list, int num,
+				      int writable, void **cookies)
+{
+	struct vring_packed_desc *desc = vq->vq_packed_ring.desc;
+	struct vq_desc_extra *dxp;
+	uint16_t flags, idx, id;
+	bool wrap;
+	int i;
+
+	flags = writable ? VRING_DESC_F_WRITE : 0;
+
+	/* Fill all the descriptors but their flags */
+	idx = vq->vq_packed_avail_idx;
+	wrap = vq->vq_packed_avail_wrap;
+	for (i = 0; i < num; i++) {
+		id = vq->vq_desc_head_idx;
+		VQ_RING_ASSERT_VALID_IDX(vq, id);
+		dxp = &vq->vq_descx[id];
+
+		VQASSERT(vq, dxp->cookie == NULL,
+			 "cookie already exists for index");
+
+		vq->vq_desc_head_idx = dxp->next;
+		dxp->cookie = cookies[i];
+		dxp->ndescs = 1;
+		dxp->len = buf_list[i].len;
+
+		desc[idx].addr = virtqueue_virt_to_phys(vq, buf_list[i].buf);
+		desc[idx].len = buf_list[i].len;
+		desc[idx].id = id;
+
+		idx = vq_packed_advance(vq, idx, 1, &wrap);
+	}
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/* Then make them available to the device */
+	idx = vq->vq_packed_avail_idx;
+	wrap = vq->vq_packed_avail_wrap;
+	for (i = 0; i < num; i++) {
+		desc[idx].flags = vq_packed_avail_flags(wrap) | flags;
+		VRING_FLUSH(&desc[idx], sizeof(desc[idx]));
+		idx = vq_packed_advance(vq, idx, 1, &wrap);
+	}
+
+	vq->vq_packed_avail_idx = idx;
+	vq->vq_packed_avail_wrap = wrap;
+	vq->vq_free_cnt -= num;
+
+	/* Packed rings count the slots made available until virtqueue_kick() */
+	vq->vq_queued_cnt += num;
+
+	return VQUEUE_SUCCESS;
+}
+
+/*
+ *
+ * vq_packed_add_consumed_buffer_batch
+ *
+ */
+static int vq_packed_add_consumed_buffer_batch(struct virtqueue *vq,
+					       uint16_t *ids, uint32_t *lens,
+					       int num)
+{
+	struct vring_packed_desc *desc = vq->vq_packed_ring.desc;
+	uint16_t idx, ndescs;
+	bool wrap;
+	int i;
+
+	VQUEUE_BUSY(vq);
+
+	/* Fill all the used descriptors but their flags */
+	idx = vq->vq_packed_used_idx;
+	wrap = vq->vq_packed_used_wrap;
+	for (i = 0; i < num; i++) {
+		desc[idx].id = ids[i];
+		desc[idx].len = lens[i];
+		idx = vq_packed_advance(vq, idx, vq->vq_descx[ids[i]].ndescs,
+					&wrap);
+	}
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/* Then mark them used */
+	idx = vq->vq_packed_used_idx;
+	wrap = vq->vq_packed_used_wrap;
+	for (i = 0; i < num; i++) {
+		desc[idx].flags = vq_packed_used_flags(wrap);
+
+		/* The used descriptor is read by driver, so we need to flush it */
+		VRING_FLUSH(&desc[idx], sizeof(desc[idx]));
+
+		ndescs = vq->vq_descx[ids[i]].ndescs;
+		idx = vq_packed_advance(vq, idx, ndescs, &wrap);
+
+		/* Packed rings count the slots marked used until virtqueue_kick() */
+		vq->vq_queued_cnt += ndescs;
+	}
+
+	vq->vq_packed_used_idx = idx;
+	vq->vq_packed_used_wrap = wrap;
+
+	VQUEUE_IDLE(vq);
+
+	return VQUEUE_SUCCESS;
+}
+
+/*
+ *
+ * vq_packed_get_desc_size
+ *
+ */
+static uint32_t vq_packed_get_desc_size(struct virtqueue *vq)
+{
+	struct vring_packed_desc *dp;
+
+	dp = &vq->vq_packed_ring.desc[vq->vq_available_idx];
+	VRING_INVALIDATE(dp, sizeof(*dp));
+	if (!vq_packed_desc_is_avail(dp->flags, vq->vq_packed_avail_wrap))
+		return 0;
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	return dp->len;
+}
+
+/*
+ *
+ * vq_packed_disable_interrupt
+ *
+ */
+static void vq_packed_disable_interrupt(struct virtqueue *vq)
+{
+	struct vring_packed_desc_event *event = NULL;
+
+	if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev))
+		event = vq->vq_packed_ring.driver;
+	if (VIRTIO_ROLE_IS_DEVICE(vq->vq_dev))
+		event = vq->vq_packed_ring.device;
+	if (!event)
+		return;
+
+	event->flags = VRING_PACKED_EVENT_FLAG_DISABLE;
+	VRING_FLUSH(event, sizeof(*event));
+}
+
+/*
+ *
+ * vq_packed_enable_interrupt
+ *
+ */
+static int vq_packed_enable_interrupt(struct virtqueue *vq, uint16_t ndesc)
+{
+	struct vring_packed_desc_event *event = NULL;
+	struct vring_packed_desc *dp;
+	uint16_t idx = 0;
+	bool wrap = false;
+
+	if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev)) {
+		event = vq->vq_packed_ring.driver;
+		wrap = vq->vq_packed_used_wrap;
+		idx = vq_packed_advance(vq, vq->vq_used_cons_idx, ndesc, &wrap);
+	}
+	if (VIRTIO_ROLE_IS_DEVICE(vq->vq_dev)) {
+		event = vq->vq_packed_ring.device;
+		wrap = vq->vq_packed_avail_wrap;
+		idx = vq_packed_advance(vq, vq->vq_available_idx, ndesc, &wrap);
+	}
+	if (!event)
+		return 0;
+
+	if (vq->vq_dev->features & VIRTIO_RING_F_EVENT_IDX) {
+		event->off_wrap = idx | (wrap << VRING_PACKED_EVENT_F_WRAP_CTR);
+		atomic_thread_fence(memory_order_seq_cst);
+		event->flags = VRING_PACKED_EVENT_FLAG_DESC;
+	} else {
+		event->flags = VRING_PACKED_EVENT_FLAG_ENABLE;
+	}
+	VRING_FLUSH(event, sizeof(*event));
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/*
+	 * Enough items may have already been consumed to meet our threshold
+	 * since we last checked. Let our caller know so it processes the new
+	 * entries.
+	 */
+	dp = &vq->vq_packed_ring.desc[idx];
+	VRING_INVALIDATE(dp, sizeof(*dp));
+	if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev))
+		return vq_packed_desc_is_used(dp->flags, wrap);
+
+	return vq_packed_desc_is_avail(dp->flags, wrap);
+}
+
+/*
+ *
+ * vq_packed_must_notify
+ *
+ */
+static int vq_packed_must_notify(struct virtqueue *vq)
+{
+	struct vring_packed_desc_event *event = NULL;
+	uint16_t new_idx = 0, prev_idx, event_idx, off_wrap, flags;
+	bool wrap = false;
+
+	/* CACHE: event suppression areas are written by remote */
+	if (VIRTIO_ROLE_IS_DRIVER(vq->vq_dev)) {
+		event = vq->vq_packed_ring.device;
+		new_idx = vq->vq_packed_avail_idx;
+		wrap = vq->vq_packed_avail_wrap;
+	}
+	if (VIRTIO_ROLE_IS_DEVICE(vq->vq_dev)) {
+		event = vq->vq_packed_ring.driver;
+		new_idx = vq->vq_packed_used_idx;
+		wrap = vq->vq_packed_used_wrap;
+	}
+	if (!event)
+		return 0;
+
+	VRING_INVALIDATE(event, sizeof(*event));
+	flags = event->flags;
+	if (flags != VRING_PACKED_EVENT_FLAG_DESC)
+		return flags != VRING_PACKED_EVENT_FLAG_DISABLE;
+
+	off_wrap = event->off_wrap;
+	event_idx = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+	if ((off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR) != wrap)
+		event_idx -= vq->vq_nentries;
+	prev_idx = new_idx - vq->vq_queued_cnt;
+
+	return vring_need_event(event_idx, new_idx, prev_idx) != 0;
+}
+
+/*
+ *
+ * vq_packed_dump
+ *
+ */
+static void vq_packed_dump(struct virtqueue *vq)
+{
+	metal_log(METAL_LOG_DEBUG,
+		  "VQ: %s - packed size=%d; free=%d; queued=%d; "
+		  "avail_idx=%d; avail_wrap=%d; used_idx=%d; used_wrap=%d; "
+		  "available_idx=%d; used_cons_idx=%d\r\n",
+		  vq->vq_name, vq->vq_nentries, vq->vq_free_cnt,
+		  vq->vq_queued_cnt, vq->vq_packed_avail_idx,
+		  vq->vq_packed_avail_wrap, vq->vq_packed_used_idx,
+		  vq->vq_packed_used_wrap, vq->vq_available_idx,
+		  vq->vq_used_cons_idx);
+}